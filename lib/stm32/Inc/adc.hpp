@@ -3,6 +3,8 @@
 #include <array>
 #include <cstdint>
 
+#include <util.hpp>
+
 #ifdef STM32
 #include "main.h"
 #endif // STM32
@@ -18,10 +20,17 @@ namespace mrover {
         struct Options {
             uint32_t timeout_ms{10};
             bool use_dma{false};
+            // conversions started by the timer trigger set up in CubeMX, streamed into a circular DMA buffer;
+            // needs use_dma, a circular half-word DMA channel and DMA continuous requests
+            bool triggered{false};
         };
 
         virtual uint32_t get_channel_value(size_t index) = 0;
+        virtual void start_injected(uint32_t channel, uint32_t trigger) = 0;
+        virtual uint32_t get_injected_value() const = 0;
         virtual void handle_conv_complete() = 0;
+        virtual void handle_half_complete() = 0;
+        [[nodiscard]] virtual bool is_data_ready() const = 0;
         virtual void start() = 0;
         virtual ADC_HandleTypeDef* handle() const = 0;
         virtual ~ADCBase() = default;
@@ -31,9 +40,16 @@ namespace mrover {
 
     /**
      * Analog-to-Digital Converter implementation.
+     *
+     * Triggered acquisition double-buffers through the DMA half and full complete interrupts:
+     * while the DMA fills one half, the other is averaged per channel into the latest values,
+     * which readers pick up without blocking or masking interrupts.
+     * Hardware oversampling, if enabled in CubeMX, filters each conversion before it reaches the buffer.
+     *
      * @tparam NumChannels The number of ADC channels in the scan sequence
+     * @tparam SamplesPerHalf Scans averaged per half buffer in triggered acquisition
      */
-    template<size_t NumChannels>
+    template<size_t NumChannels, size_t SamplesPerHalf = 1>
     class ADC : public ADCBase {
     public:
         ADC() = default;
@@ -46,12 +62,20 @@ namespace mrover {
             start();
         }
 
+        // pinned: the DMA buffer and s_instance both point into this object, build it in place
         ADC(const ADC&) = delete;
         ADC& operator=(const ADC&) = delete;
-        ADC(ADC&&) noexcept = default;
-        ADC& operator=(ADC&&) noexcept = default;
+        ADC(ADC&&) = delete;
+        ADC& operator=(ADC&&) = delete;
 
         auto start() -> void override {
+            if (m_options.triggered) {
+                // runs from the first start on, every half buffer refreshes the latest values
+                if (m_running) return;
+                check(HAL_ADC_Start_DMA(m_hadc, reinterpret_cast<uint32_t*>(m_buffer.data()), static_cast<uint32_t>(m_buffer.size())) == HAL_OK, Error_Handler);
+                m_running = true;
+                return;
+            }
             __disable_irq();
             if (m_options.use_dma) {
                 HAL_ADC_Start_DMA(m_hadc, m_values.data(), static_cast<uint32_t>(NumChannels));
@@ -61,7 +85,8 @@ namespace mrover {
             __enable_irq();
         }
 
-        auto stop() const -> void {
+        auto stop() -> void {
+            m_running = false;
             __disable_irq();
             if (m_options.use_dma) {
                 HAL_ADC_Stop_DMA(m_hadc);
@@ -71,8 +96,9 @@ namespace mrover {
             __enable_irq();
         }
 
-        [[nodiscard]] auto is_data_ready() const -> bool {
-            return m_data_ready;
+        // polled reads convert on demand, so they are always ready
+        [[nodiscard]] auto is_data_ready() const -> bool override {
+            return !m_options.use_dma || m_data_ready;
         }
 
         auto clear_data_ready() -> void {
@@ -81,27 +107,63 @@ namespace mrover {
             __enable_irq();
         }
 
-        auto get_channel_value(size_t index) -> uint32_t override {
-            __disable_irq();
-            HAL_ADC_Start(m_hadc);
+        /**
+         * @param index position of the channel in the scan sequence, from 0
+         * @return latest value, only the polled acquisition converts here and waits for the result
+         */
+        auto get_channel_value(size_t const index) -> uint32_t override {
+            if (index >= NumChannels) return 0;
+            if (m_options.triggered) return m_latest[index];
+            if (m_options.use_dma) return m_values[index];
+
             uint32_t value = 0;
-            index--;
-            if (index >= NumChannels) {
-                value = 0;
-            } else if (m_options.use_dma) {
-                value = m_values[index];
-            } else if (HAL_ADC_PollForConversion(m_hadc, m_options.timeout_ms) == HAL_OK) {
+            HAL_ADC_Start(m_hadc);
+            if (HAL_ADC_PollForConversion(m_hadc, m_options.timeout_ms) == HAL_OK) {
                 value = HAL_ADC_GetValue(m_hadc);
             }
             HAL_ADC_Stop(m_hadc);
-            __enable_irq();
             return value;
         }
 
+        /**
+         * Convert one channel in the injected group on a hardware trigger, independent of the regular group.
+         * The result is only read back, there is no interrupt, so sampling the middle of a PWM pulse costs no CPU.
+         * @param channel ADC_CHANNEL_x to convert
+         * @param trigger ADC_EXTERNALTRIGINJEC_x event that starts each conversion, e.g. a PWM timer compare
+         */
+        void start_injected(uint32_t const channel, uint32_t const trigger) override {
+            ADC_InjectionConfTypeDef config{};
+            config.InjectedChannel = channel;
+            config.InjectedRank = ADC_INJECTED_RANK_1;
+            config.InjectedSamplingTime = ADC_SAMPLETIME_2CYCLES_5;
+            config.InjectedSingleDiff = ADC_SINGLE_ENDED;
+            config.InjectedOffsetNumber = ADC_OFFSET_NONE;
+            config.InjectedOffset = 0;
+            config.InjectedNbrOfConversion = 1;
+            config.InjectedDiscontinuousConvMode = DISABLE;
+            config.AutoInjectedConv = DISABLE;
+            config.QueueInjectedContext = DISABLE;
+            config.ExternalTrigInjecConv = trigger;
+            config.ExternalTrigInjecConvEdge = ADC_EXTERNALTRIGINJECCONV_EDGE_RISING;
+            config.InjecOversamplingMode = DISABLE;
+            check(HAL_ADCEx_InjectedConfigChannel(m_hadc, &config) == HAL_OK, Error_Handler);
+            check(HAL_ADCEx_InjectedStart(m_hadc) == HAL_OK, Error_Handler);
+        }
+
+        // latest injected conversion, never blocks
+        [[nodiscard]] auto get_injected_value() const -> uint32_t override {
+            return HAL_ADCEx_InjectedGetValue(m_hadc, ADC_INJECTED_RANK_1);
+        }
+
         void handle_conv_complete() override {
+            if (m_options.triggered) average(SamplesPerHalf);
             m_data_ready = true;
         }
 
+        void handle_half_complete() override {
+            if (m_options.triggered) average(0);
+        }
+
         [[nodiscard]] auto handle() const -> ADC_HandleTypeDef* override {
             return m_hadc;
         }
@@ -111,6 +173,23 @@ namespace mrover {
         Options m_options;
         std::array<uint32_t, NumChannels> m_values;
         bool volatile m_data_ready{false};
+
+        // triggered acquisition, two halves of SamplesPerHalf interleaved scans
+        std::array<uint16_t, 2 * SamplesPerHalf * NumChannels> m_buffer{};
+        std::array<uint32_t volatile, NumChannels> m_latest{};
+        bool m_running{false};
+
+        // the DMA is filling the other half meanwhile, so this one stays put
+        auto average(size_t const first_scan) -> void {
+            for (size_t channel = 0; channel < NumChannels; ++channel) {
+                uint32_t sum = 0;
+                for (size_t scan = first_scan; scan < first_scan + SamplesPerHalf; ++scan) {
+                    sum += m_buffer[scan * NumChannels + channel];
+                }
+                // word stores are atomic, each channel is read on its own
+                m_latest[channel] = (sum + SamplesPerHalf / 2) / SamplesPerHalf;
+            }
+        }
     };
 #else  // HAL_ADC_MODULE_ENABLED
     class __attribute__((unavailable("enable 'ADC' in STM32CubeMX to use mrover::ADCBase"))) ADCBase {
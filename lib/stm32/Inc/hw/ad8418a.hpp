@@ -3,7 +3,9 @@
 #include <adc.hpp>
 #include <cmath>
 #include <filtering.hpp>
+#include <limits>
 #include <logger.hpp>
+#include <optional>
 
 namespace mrover {
 #ifdef HAL_ADC_MODULE_ENABLED
@@ -15,13 +17,16 @@ namespace mrover {
             float vref{3.3f};
             float vcm{1.598f}; // TODO make these parameters
             uint16_t adc_resolution{4095};
+            // sample through the ADC injected group on this ADC_EXTERNALTRIGINJEC_x event instead of polling
+            std::optional<uint32_t> sample_trigger{};
+            uint32_t sample_channel{}; // ADC_CHANNEL_x of the sense output, for triggered sampling
         };
 
         AD8418A() = default;
 
         /**
          * @param adc Reference to the ADC wrapper (e.g., ADC<3>)
-         * @param channel The index of the channel this sensor is wired to
+         * @param channel Position of the sense output in the ADC scan sequence, from 0
          */
         AD8418A(ADCBase* adc, uint8_t const channel)
             : m_adc{adc}, m_channel{channel} {}
@@ -30,13 +35,70 @@ namespace mrover {
             m_enabled = enabled;
             m_options = options;
             m_current_filter.add_reading(0.0f);
-            m_base = (static_cast<float>(m_adc->get_channel_value(m_channel)) / static_cast<float>(m_options.adc_resolution)) * m_options.vref;
+            if (m_triggered) return; // keep the offset measured at startup, the output may be driven by now
+            if (m_options.sample_trigger) {
+                m_adc->start_injected(m_options.sample_channel, *m_options.sample_trigger);
+                m_triggered = true;
+                calibrate();
+                return;
+            }
+            // a streaming ADC may not have its first result yet, take the offset from it then
+            m_base_pending = true;
+            measure_base();
+        }
+
+        /**
+         * Measure the zero current output over the next CALIBRATION_SAMPLES triggered samples.
+         * The bridge must not be driven until calibrated() is true.
+         */
+        auto calibrate() -> void {
+            m_calibration_sum = 0.0f;
+            m_calibration_count = 0;
+            m_calibrated = false;
+        }
+
+        [[nodiscard]] auto calibrated() const -> bool {
+            return m_calibrated;
+        }
+
+        /**
+         * Take the latest triggered sample, from the loop that runs on the trigger timer.
+         * Reads back the last conversion without waiting, so it is safe to call from an interrupt.
+         */
+        auto update_triggered() -> void {
+            if (!m_triggered) return;
+            float const v_out = (static_cast<float>(m_adc->get_injected_value()) / static_cast<float>(m_options.adc_resolution)) * m_options.vref;
+            if (!m_calibrated) {
+                m_calibration_sum += v_out;
+                if (++m_calibration_count == CALIBRATION_SAMPLES) {
+                    m_base = m_calibration_sum / static_cast<float>(CALIBRATION_SAMPLES);
+                    m_calibrated = true;
+                }
+                return;
+            }
+            m_sample_current = (v_out - m_base) / (m_options.gain * m_options.shunt_resistance);
+        }
+
+        /**
+         * Latest unfiltered triggered sample for a current loop, NaN until calibrated.
+         */
+        [[nodiscard]] auto sample_current() const -> float {
+            return m_calibrated ? m_sample_current : std::numeric_limits<float>::quiet_NaN();
         }
 
         auto update_sensor() -> void {
             if (!m_enabled || m_adc == nullptr) return;
+            if (m_base_pending && !measure_base()) return;
 
-            // Retrieve the raw value from the ADC wrapper (DMA or Polling)
+            // the current loop keeps the triggered sample fresh, only filter it here
+            if (m_triggered) {
+                m_current_filter.add_reading(m_calibrated ? m_sample_current : 0.0f);
+                m_previous = m_current;
+                m_current = m_current_filter.get_filtered();
+                return;
+            }
+
+            // Retrieve the raw value from the ADC wrapper (triggered DMA, DMA or polling)
             uint32_t const raw_val = m_adc->get_channel_value(m_channel);
             // Logger::instance().info("Raw Value: %u", raw_val);
 
@@ -73,7 +135,15 @@ namespace mrover {
         }
 
     private:
+        auto measure_base() -> bool {
+            if (!m_adc->is_data_ready()) return false;
+            m_base = (static_cast<float>(m_adc->get_channel_value(m_channel)) / static_cast<float>(m_options.adc_resolution)) * m_options.vref;
+            m_base_pending = false;
+            return true;
+        }
+
         static constexpr std::size_t CURRENT_BUFFER_SIZE = 10;
+        static constexpr uint32_t CALIBRATION_SAMPLES = 256;
         ADCBase* m_adc{nullptr};
         float m_current{};
         float m_previous{};
@@ -81,8 +151,16 @@ namespace mrover {
         uint8_t m_channel{0};
 
         bool m_enabled{false};
+        bool m_base_pending{false};
         Options m_options{};
 
+        // triggered sampling
+        bool m_triggered{false};
+        bool volatile m_calibrated{false};
+        float volatile m_sample_current{};
+        float m_calibration_sum{};
+        uint32_t m_calibration_count{};
+
         // float m_current{0.0f};
         RunningMeanFilter<float, CURRENT_BUFFER_SIZE> m_current_filter;
     };
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <cstdint>
+#include <span>
+#include <utility>
+
+#include <crc.hpp>
 
 namespace mrover {
 
@@ -95,6 +102,282 @@ namespace mrover {
         }
     }
 
+    template<typename Config>
+    static constexpr std::size_t config_image_size = (Config::size_bytes() + 7) & ~std::size_t{7};
+
+    /**
+     * Log-structured config storage over the last STORE_PAGES flash pages.
+     *
+     * A page holds a snapshot of the whole config followed by append-only records, one double word each,
+     * so a register write costs a single double word program instead of a page erase.
+     * Reads are served from a RAM shadow rebuilt at boot from the newest valid snapshot and its records.
+     *
+     * When a page fills up the shadow is written as a new snapshot to the other page. Its header is
+     * programmed last and carries a CRC of the snapshot, so an interrupted compaction leaves the
+     * previous page in charge.
+     *
+     * Writes only touch the shadow and mark bytes dirty; nothing reaches flash until flush(), which the
+     * board calls from its main loop when a flash stall cannot disturb control (motor stopped, loop idle).
+     *
+     * Page layout: magic, generation | image size, image CRC | image | records...
+     * Record layout: address, size, check (low half of a CRC-32), value
+     */
+    template<typename Config>
+    class ConfigStore {
+        using Mem = Config::mem_layout;
+
+        static constexpr int STORE_PAGES = 2;
+        static constexpr uint32_t MAGIC = 0x4746434D; // "MCFG"
+        static constexpr std::size_t HEADER_SIZE = 16;
+        static constexpr std::size_t IMAGE_SIZE = config_image_size<Config>;
+        static constexpr std::size_t RECORDS_BEGIN = HEADER_SIZE + IMAGE_SIZE;
+        static constexpr uint64_t ERASED = 0xFFFFFFFFFFFFFFFF;
+
+        static_assert(RECORDS_BEGIN < Mem::PAGE_SIZE, "config does not fit a store page");
+
+        struct header_t {
+            uint32_t magic;
+            uint32_t generation;
+            uint16_t image_size;
+            uint16_t reserved;
+            uint32_t image_crc;
+        };
+        static_assert(sizeof(header_t) == HEADER_SIZE);
+
+        std::array<uint8_t, IMAGE_SIZE> m_shadow{};
+        std::bitset<IMAGE_SIZE> m_dirty{};
+        bool m_snapshot_pending{};
+        int m_page{-1};
+        uint32_t m_generation{};
+        std::size_t m_write_offset{};
+        bool m_loaded{};
+
+        static auto page_addr(int const page) -> uint32_t {
+            return Mem::FLASH_BEGIN_ADDR + Mem::PAGE_SIZE * (Mem::NUM_PAGES - STORE_PAGES + page);
+        }
+
+        static auto read_double_word(uint32_t const addr) -> uint64_t {
+            uint64_t double_word;
+            std::memcpy(&double_word, reinterpret_cast<void const*>(addr), sizeof(double_word));
+            return double_word;
+        }
+
+        static auto image_crc(std::span<uint8_t const> const image) -> uint32_t {
+            Crc32 crc;
+            crc.update(image);
+            return crc.value();
+        }
+
+        static auto record_check(uint8_t const address, uint8_t const size, uint32_t const value) -> uint16_t {
+            Crc32 crc;
+            crc.update(address);
+            crc.update(size);
+            for (int i = 0; i < 4; ++i) crc.update(static_cast<uint8_t>(value >> (8 * i)));
+            return static_cast<uint16_t>(crc.value());
+        }
+
+        static auto erase_page(int const page) -> bool {
+            FLASH_EraseInitTypeDef erase_init;
+            erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
+            erase_init.Page = (page_addr(page) - 0x08000000) / Mem::PAGE_SIZE;
+            erase_init.NbPages = 1;
+
+            uint32_t page_error = 0;
+            HAL_FLASH_Unlock();
+            bool const ok = HAL_FLASHEx_Erase(&erase_init, &page_error) == HAL_OK;
+            HAL_FLASH_Lock();
+            return ok;
+        }
+
+        static auto program_double_word(uint32_t const addr, uint64_t const double_word) -> bool {
+            HAL_FLASH_Unlock();
+            bool const ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, addr, double_word) == HAL_OK;
+            HAL_FLASH_Lock();
+            return ok;
+        }
+
+        [[nodiscard]] auto valid_header(int const page, header_t& header) const -> bool {
+            std::memcpy(&header, reinterpret_cast<void const*>(page_addr(page)), sizeof(header));
+            if (header.magic != MAGIC || header.image_size != IMAGE_SIZE) return false;
+            std::span const image{reinterpret_cast<uint8_t const*>(page_addr(page) + HEADER_SIZE), IMAGE_SIZE};
+            return image_crc(image) == header.image_crc;
+        }
+
+        auto load() -> void {
+            if (m_loaded) return;
+            m_loaded = true;
+
+            for (int page = 0; page < STORE_PAGES; ++page) {
+                if (header_t header{}; valid_header(page, header) && (m_page < 0 || header.generation > m_generation)) {
+                    m_page = page;
+                    m_generation = header.generation;
+                }
+            }
+
+            if (m_page < 0) {
+                // no snapshot yet, adopt the raw config the single page format kept in the last page
+                std::memcpy(m_shadow.data(), reinterpret_cast<void const*>(page_addr(STORE_PAGES - 1)), IMAGE_SIZE);
+                compact(m_shadow);
+                return;
+            }
+
+            std::memcpy(m_shadow.data(), reinterpret_cast<void const*>(page_addr(m_page) + HEADER_SIZE), IMAGE_SIZE);
+            m_write_offset = RECORDS_BEGIN;
+            for (; m_write_offset < Mem::PAGE_SIZE; m_write_offset += 8) {
+                uint64_t const record = read_double_word(page_addr(m_page) + m_write_offset);
+                if (record == ERASED) break;
+
+                // a record torn by a reset fails its check and is skipped
+                auto const address = static_cast<uint8_t>(record);
+                auto const size = static_cast<uint8_t>(record >> 8);
+                auto const check = static_cast<uint16_t>(record >> 16);
+                auto const value = static_cast<uint32_t>(record >> 32);
+                if (size == 0 || size > 4 || address + size > IMAGE_SIZE || check != record_check(address, size, value)) continue;
+                std::memcpy(&m_shadow[address], &value, size);
+            }
+        }
+
+        auto compact(std::span<uint8_t const, IMAGE_SIZE> const image) -> bool {
+            int const target = m_page < 0 ? 0 : (m_page + 1) % STORE_PAGES;
+            uint32_t const base = page_addr(target);
+
+            bool ok = erase_page(target);
+            for (std::size_t i = 0; ok && i < IMAGE_SIZE; i += 8) {
+                uint64_t double_word;
+                std::memcpy(&double_word, &image[i], sizeof(double_word));
+                if (double_word != ERASED) ok = program_double_word(base + HEADER_SIZE + i, double_word);
+            }
+            if (!ok) return false;
+
+            header_t const header{MAGIC, m_generation + 1, IMAGE_SIZE, 0xFFFF, image_crc(image)};
+            uint64_t header_words[2];
+            std::memcpy(header_words, &header, sizeof(header));
+            // the word holding the magic goes last, it is what makes the page valid
+            if (!program_double_word(base + 8, header_words[1]) || !program_double_word(base, header_words[0])) return false;
+
+            m_page = target;
+            m_generation = header.generation;
+            m_write_offset = RECORDS_BEGIN;
+            return true;
+        }
+
+        auto append(uint8_t const address, uint8_t const size, uint32_t const value) -> bool {
+            uint64_t const record = address |
+                                    static_cast<uint64_t>(size) << 8 |
+                                    static_cast<uint64_t>(record_check(address, size, value)) << 16 |
+                                    static_cast<uint64_t>(value) << 32;
+            bool const ok = program_double_word(page_addr(m_page) + m_write_offset, record);
+            m_write_offset += 8;
+            return ok;
+        }
+
+        ConfigStore() = default;
+
+    public:
+        static auto instance() -> ConfigStore& {
+            static ConfigStore store;
+            return store;
+        }
+
+        auto read(std::size_t const offset, void* dst, std::size_t const size) -> void {
+            load();
+            std::memcpy(dst, &m_shadow[offset], size);
+        }
+
+        /**
+         * Update the shadow, the change is programmed by the next flush().
+         */
+        auto write(std::size_t const offset, void const* src, std::size_t const size) -> void {
+            load();
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            std::memcpy(&m_shadow[offset], src, size);
+            for (std::size_t i = offset; i < offset + size; ++i) m_dirty.set(i);
+            __set_PRIMASK(primask);
+        }
+
+        [[nodiscard]] auto image() -> std::span<uint8_t const, IMAGE_SIZE> {
+            load();
+            return m_shadow;
+        }
+
+        /**
+         * Replace the whole config at once, the next flush() writes it as a fresh snapshot.
+         */
+        auto replace(std::span<uint8_t const, IMAGE_SIZE> const image) -> void {
+            load();
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            std::ranges::copy(image, m_shadow.begin());
+            m_snapshot_pending = true;
+            __set_PRIMASK(primask);
+        }
+
+        [[nodiscard]] auto pending() const -> bool {
+            return m_snapshot_pending || m_dirty.any();
+        }
+
+        /**
+         * Program pending changes: dirty bytes as records of up to four bytes, or a new snapshot when the
+         * whole config was replaced or the page is full. Stalls instruction fetch while flash is busy.
+         *
+         * Writes from interrupts may land during the flush, they stay dirty for the next one.
+         */
+        auto flush() -> bool {
+            load();
+            if (!pending()) return true;
+
+            std::array<uint8_t, IMAGE_SIZE> image;
+            std::bitset<IMAGE_SIZE> dirty;
+            bool snapshot;
+            {
+                uint32_t const primask = __get_PRIMASK();
+                __disable_irq();
+                image = m_shadow;
+                dirty = std::exchange(m_dirty, {});
+                snapshot = std::exchange(m_snapshot_pending, false);
+                __set_PRIMASK(primask);
+            }
+
+            // dirty runs, split into records of at most four bytes
+            auto const for_each_record = [&dirty](auto&& f) -> void {
+                for (std::size_t i = 0; i < IMAGE_SIZE;) {
+                    if (!dirty[i]) {
+                        ++i;
+                        continue;
+                    }
+                    uint8_t size = 1;
+                    while (size < 4 && i + size < IMAGE_SIZE && dirty[i + size]) ++size;
+                    f(static_cast<uint8_t>(i), size);
+                    i += size;
+                }
+            };
+
+            std::size_t records = 0;
+            for_each_record([&records](uint8_t, uint8_t) -> void { ++records; });
+
+            bool ok = true;
+            if (snapshot || m_page < 0 || m_write_offset + records * 8 > Mem::PAGE_SIZE) {
+                ok = compact(image);
+            } else {
+                for_each_record([&](uint8_t const address, uint8_t const size) -> void {
+                    uint32_t value = 0;
+                    std::memcpy(&value, &image[address], size);
+                    ok = append(address, size, value) && ok;
+                });
+            }
+
+            if (!ok) {
+                // retry with a whole snapshot on the next flush
+                uint32_t const primask = __get_PRIMASK();
+                __disable_irq();
+                m_snapshot_pending = true;
+                __set_PRIMASK(primask);
+            }
+            return ok;
+        }
+    };
+
     template<typename T>
     struct reg_t {
         using value_t = T;
@@ -103,52 +386,97 @@ namespace mrover {
         static consteval auto size() -> size_t { return sizeof(T); }
         [[nodiscard]] constexpr auto reg() const -> uint8_t { return addr; }
 
-        template<typename Config>
-        static constexpr auto get_base_addr() -> uint32_t {
-            using Mem = Config::mem_layout;
-            return Mem::FLASH_BEGIN_ADDR + (Mem::PAGE_SIZE * (Mem::NUM_PAGES - 1));
-        }
-
         template<typename Config>
         auto read(Config const& cfg) const -> T {
             if (!value.has_value()) {
-                uint32_t const phys_addr = get_base_addr<Config>() + addr;
                 T temp;
-                std::memcpy(&temp, reinterpret_cast<void*>(phys_addr), sizeof(T));
+                ConfigStore<Config>::instance().read(addr, &temp, sizeof(T));
                 value = temp;
             }
             return *value;
         }
 
+        // lands in the RAM shadow immediately, Config::commit() programs it to flash
         template<typename Config>
         void write(Config const& cfg, T v) const {
-            using Mem = Config::mem_layout;
             value = v;
+            ConfigStore<Config>::instance().write(addr, &v, sizeof(T));
+        }
+    };
 
-            uint32_t const page_addr = get_base_addr<Config>();
-            static uint8_t page_buffer[Mem::PAGE_SIZE];
+    /**
+     * Stages many register writes in RAM and replaces the config with them, written as a single snapshot.
+     *
+     * Data frames are numbered from zero and must arrive in order; a frame zero starts a new transaction.
+     * The commit carries the frame count and a CRC-32 over every staged pair, each pair being the
+     * address byte followed by the 32-bit raw value in little endian.
+     */
+    template<typename Config>
+    class ConfigBatch {
+    public:
+        enum class status_t : uint8_t {
+            OK = 0,
+            SEQUENCE_ERROR,
+            UNKNOWN_ADDRESS,
+            CRC_MISMATCH,
+            FLASH_ERROR,
+            NO_TRANSACTION,
+        };
 
-            std::memcpy(page_buffer, reinterpret_cast<void*>(page_addr), Mem::PAGE_SIZE);
-            std::memcpy(&page_buffer[addr], &v, sizeof(T));
+        static constexpr std::size_t IMAGE_SIZE = config_image_size<Config>;
 
-            HAL_FLASH_Unlock();
-            FLASH_EraseInitTypeDef erase_init;
-            erase_init.TypeErase = FLASH_TYPEERASE_PAGES;
-            erase_init.Page = (page_addr - 0x08000000) / Mem::PAGE_SIZE;
-            erase_init.NbPages = 1;
+        auto stage(Config const& cfg, uint8_t const sequence, std::span<std::pair<uint8_t, uint32_t> const> const pairs) -> status_t {
+            if (sequence == 0) {
+                std::ranges::copy(ConfigStore<Config>::instance().image(), m_image.begin());
+                m_crc.reset();
+                m_next_sequence = 0;
+                m_count = 0;
+                m_active = true;
+            }
+            if (!m_active) return status_t::NO_TRANSACTION;
+            if (sequence != m_next_sequence) {
+                m_active = false;
+                return status_t::SEQUENCE_ERROR;
+            }
 
-            uint32_t page_error = 0;
-            if (HAL_FLASHEx_Erase(&erase_init, &page_error) == HAL_OK) {
-                for (size_t i = 0; i < Mem::PAGE_SIZE; i += 8) {
-                    uint64_t double_word;
-                    std::memcpy(&double_word, &page_buffer[i], 8);
-                    if (double_word != 0xFFFFFFFFFFFFFFFF) {
-                        HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, page_addr + i, double_word);
-                    }
+            for (auto const& [address, raw]: pairs) {
+                if (!cfg.stage_raw(address, raw, m_image)) {
+                    m_active = false;
+                    return status_t::UNKNOWN_ADDRESS;
                 }
+                m_crc.update(address);
+                for (int i = 0; i < 4; ++i) m_crc.update(static_cast<uint8_t>(raw >> (8 * i)));
+                ++m_count;
             }
-            HAL_FLASH_Lock();
+            ++m_next_sequence;
+            return status_t::OK;
         }
+
+        /**
+         * @param apply false discards the staged writes
+         */
+        auto commit(Config const& cfg, uint8_t const frames, uint32_t const crc, bool const apply) -> status_t {
+            if (!m_active) return status_t::NO_TRANSACTION;
+            m_active = false;
+            if (!apply) return status_t::OK;
+            if (frames != m_next_sequence) return status_t::SEQUENCE_ERROR;
+            if (crc != m_crc.value()) return status_t::CRC_MISMATCH;
+
+            ConfigStore<Config>::instance().replace(m_image);
+            cfg.invalidate();
+            return status_t::OK;
+        }
+
+        [[nodiscard]] auto staged() const -> uint8_t {
+            return m_count;
+        }
+
+    private:
+        std::array<uint8_t, IMAGE_SIZE> m_image{};
+        Crc32 m_crc{};
+        uint8_t m_next_sequence{};
+        uint8_t m_count{};
+        bool m_active{};
     };
 
     template<auto cfg_ptr_v, size_t bit = 0, size_t width = 0>
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <optional>
 
 #include <logger.hpp>
 #include <util.hpp>
@@ -22,6 +23,7 @@ namespace mrover {
         Pin m_direction_pin{};
         TIM_HandleTypeDef* m_timer{};
         std::uint32_t m_channel{};
+        std::optional<std::uint32_t> m_sample_channel{};
         float m_max_pwm{};
         bool m_is_inverted = false;
         bool m_is_pwm_en = false;
@@ -44,29 +46,56 @@ namespace mrover {
             // The CCR register compares its value to the timer and outputs a signal based on the result
             // The ARR register sets the limit for when the timer register resets to 0.
             auto const limit = __HAL_TIM_GetAutoreload(m_timer);
-            __HAL_TIM_SetCompare(m_timer, m_channel, static_cast<std::uint32_t>(std::round(duty_cycle * limit)));
+            write_compare(static_cast<std::uint32_t>(std::round(duty_cycle * limit)));
             // TODO(eric) we should error if the registers are null pointers
         }
 
+        auto write_compare(std::uint32_t const compare) const -> void {
+            __HAL_TIM_SetCompare(m_timer, m_channel, compare);
+            // the counter runs up from the start of the pulse, so half the compare value is its middle
+            if (m_sample_channel) __HAL_TIM_SetCompare(m_timer, *m_sample_channel, compare / 2);
+        }
+
+        /**
+         * Set up the sample channel to fire in the middle of each on-pulse, where the current ripple averages out.
+         * It is never enabled as an output, only its compare event is used, e.g. to trigger an ADC conversion.
+         */
+        auto configure_sample_trigger() const -> void {
+            TIM_OC_InitTypeDef config{};
+            config.OCMode = TIM_OCMODE_TIMING;
+            config.Pulse = 0;
+            config.OCPolarity = TIM_OCPOLARITY_HIGH;
+            config.OCFastMode = TIM_OCFAST_DISABLE;
+            check(HAL_TIM_OC_ConfigChannel(m_timer, &config, *m_sample_channel) == HAL_OK, Error_Handler);
+            // follow the pulse it samples, which only changes on the update event
+            __HAL_TIM_ENABLE_OCxPRELOAD(m_timer, *m_sample_channel);
+        }
+
     public:
         HBridge() = default;
 
-        explicit HBridge(TIM_HandleTypeDef* timer, std::uint32_t channel, Pin direction_pin) : m_direction_pin{direction_pin},
-                                                                                               m_timer{timer},
-                                                                                               m_channel{channel},
-                                                                                               m_max_pwm{0.0f} {
+        /**
+         * @param sample_channel spare channel of the PWM timer whose compare event marks the middle of each pulse
+         */
+        explicit HBridge(TIM_HandleTypeDef* timer, std::uint32_t channel, Pin direction_pin,
+                         std::optional<std::uint32_t> const sample_channel = std::nullopt) : m_direction_pin{direction_pin},
+                                                                                             m_timer{timer},
+                                                                                             m_channel{channel},
+                                                                                             m_sample_channel{sample_channel},
+                                                                                             m_max_pwm{0.0f} {
+            if (m_sample_channel) configure_sample_trigger();
             // Initialize CCR to 0 (no pulse generated)
             start();
         }
 
         auto start() -> void {
-            __HAL_TIM_SET_COMPARE(m_timer, m_channel, 0);
+            write_compare(0);
             if (!m_is_pwm_en) check(HAL_TIM_PWM_Start(m_timer, m_channel) == HAL_OK, Error_Handler);
             m_is_pwm_en = true;
         }
 
         auto stop() -> void {
-            __HAL_TIM_SET_COMPARE(m_timer, m_channel, 0);
+            write_compare(0);
             // check(HAL_TIM_PWM_Stop(m_timer, m_channel) == HAL_OK, Error_Handler);
             // m_is_pwm_en = false;
         }
@@ -89,6 +118,29 @@ namespace mrover {
         auto set_inverted(bool const inverted) -> void {
             m_is_inverted = inverted;
         }
+
+        [[nodiscard]] auto pwm_frequency() const -> float {
+            return static_cast<float>(HAL_RCC_GetSysClockFreq()) / ((m_timer->Instance->PSC + 1) * (m_timer->Instance->ARR + 1));
+        }
+
+        /**
+         * Interrupt on the PWM timer update event once every few PWM periods.
+         * The repetition counter divides the update events in hardware, so the interrupt stays locked to the PWM edge.
+         * Only advanced control timers (TIM1, TIM8, TIM20) have an 8-bit repetition counter to go past one period.
+         * @param periods PWM periods per interrupt, takes effect from the next update event
+         * @return interrupt rate in Hz
+         */
+        auto enable_update_interrupt(std::uint32_t periods) const -> float {
+            periods = std::clamp<std::uint32_t>(periods, 1, IS_TIM_REPETITION_COUNTER_INSTANCE(m_timer->Instance) ? 256 : 1);
+            if (IS_TIM_REPETITION_COUNTER_INSTANCE(m_timer->Instance)) m_timer->Instance->RCR = periods - 1;
+            __HAL_TIM_CLEAR_IT(m_timer, TIM_IT_UPDATE);
+            __HAL_TIM_ENABLE_IT(m_timer, TIM_IT_UPDATE);
+            return pwm_frequency() / static_cast<float>(periods);
+        }
+
+        auto disable_update_interrupt() const -> void {
+            __HAL_TIM_DISABLE_IT(m_timer, TIM_IT_UPDATE);
+        }
     };
 #else  // HAL_TIM_MODULE_ENABLED
     class __attribute__((unavailable("enable 'TIM' in STM32CubeMX to use mrover::HBridge"))) HBridge {
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
 #include <filtering.hpp>
+#include <seqlock.hpp>
 #include <timer.hpp>
 #include <util.hpp>
+#include <velocity_estimator.hpp>
 
 #ifdef STM32
 #include "main.h"
@@ -15,6 +19,12 @@ namespace mrover {
         float velocity; // unit of output/second
     };
 
+    enum class VelocityEstimator : std::uint8_t {
+        RUNNING_MEAN = 0,  // mean of the last count deltas over the update period
+        EDGE_TIMING = 1,   // time between captured edges, count differencing once edges come too fast
+        TRACKING_LOOP = 2, // PLL on the count
+    };
+
 #ifdef HAL_TIM_MODULE_ENABLED
     inline auto count_delta_and_update(std::uint16_t& previous, TIM_HandleTypeDef const* timer) -> std::int16_t {
         auto const now = static_cast<std::uint16_t>(__HAL_TIM_GET_COUNTER(timer));
@@ -30,39 +40,123 @@ namespace mrover {
      */
     class QuadratureEncoder {
         static constexpr std::size_t VELOCITY_BUFFER_SIZE = 16;
+        // above this many counts/s, an interrupt per edge costs more than edge timing gains, capture again below half
+        static constexpr float MAX_EDGE_RATE = 20000.0f;
+        static constexpr float EDGE_TIMEOUT_S = 0.5f;
+        static constexpr float DEFAULT_TRACKING_BANDWIDTH_HZ = 50.0f;
+
+        struct captured_edge_t {
+            std::uint32_t ticks;
+            std::uint16_t count;
+            bool valid;
+        };
 
         TIM_HandleTypeDef* m_tick_timer{};
         ITimerChannel* m_elapsed_timer{};
+        TIM_HandleTypeDef* m_timestamp_timer{};
 
         std::uint16_t m_counts_unwrapped_prev{};
+        std::int32_t m_count{};
         float m_multiplier{};
         float m_cpr{};
         bool m_initialized{false};
 
         float m_position{};
+        float m_velocity{};
+        VelocityEstimator m_estimator{VelocityEstimator::RUNNING_MEAN};
         RunningMeanFilter<float, VELOCITY_BUFFER_SIZE> m_velocity_filter;
+        EdgeTimingEstimator m_edge_estimator;
+        TrackingLoopEstimator m_tracking_estimator;
+
+        // written by the capture interrupt
+        SeqLock<captured_edge_t> m_edge;
+        bool m_capture_en{false};
 
         float m_delta_position{};
 
+        auto set_capture(bool const enable) -> void {
+            if (enable) {
+                // an edge from before the captures stopped is too old to time against
+                m_edge.write({});
+                __HAL_TIM_CLEAR_IT(m_tick_timer, TIM_IT_CC1 | TIM_IT_CC2);
+                __HAL_TIM_ENABLE_IT(m_tick_timer, TIM_IT_CC1 | TIM_IT_CC2);
+            } else {
+                __HAL_TIM_DISABLE_IT(m_tick_timer, TIM_IT_CC1 | TIM_IT_CC2);
+            }
+            m_capture_en = enable;
+        }
+
+        // counts/s from the latest captured edge, or from the count now while edges are not captured
+        auto estimate_from_edges() -> float {
+            auto const now_ticks = static_cast<std::uint32_t>(__HAL_TIM_GET_COUNTER(m_timestamp_timer));
+            EncoderEdge latest{m_count, now_ticks};
+            if (m_capture_en) {
+                if (captured_edge_t const edge = m_edge.read(); edge.valid) {
+                    latest = {m_count + static_cast<std::int16_t>(edge.count - m_counts_unwrapped_prev), edge.ticks};
+                }
+            }
+            float const counts_per_s = m_edge_estimator.update(latest, now_ticks);
+            if (m_capture_en && std::fabs(counts_per_s) > MAX_EDGE_RATE) {
+                set_capture(false);
+            } else if (!m_capture_en && std::fabs(counts_per_s) < MAX_EDGE_RATE / 2.0f) {
+                set_capture(true);
+            }
+            return counts_per_s;
+        }
+
     public:
         QuadratureEncoder() = default;
-        QuadratureEncoder(TIM_HandleTypeDef* tick_timer, ITimerChannel* elapsed_timer) : m_tick_timer{tick_timer},
-                                                                                         m_elapsed_timer{elapsed_timer} {
+
+        /**
+         * @param timestamp_timer free running timer the edges are timestamped with, needed for edge timing
+         */
+        QuadratureEncoder(TIM_HandleTypeDef* tick_timer, ITimerChannel* elapsed_timer,
+                          TIM_HandleTypeDef* timestamp_timer = nullptr) : m_tick_timer{tick_timer},
+                                                                          m_elapsed_timer{elapsed_timer},
+                                                                          m_timestamp_timer{timestamp_timer} {
             check(HAL_TIM_Encoder_Start_IT(m_tick_timer, TIM_CHANNEL_ALL) == HAL_OK, Error_Handler);
         }
 
-        auto init(float const multiplier, float const cpr) -> void {
+        /**
+         * @param bandwidth_hz tracking loop bandwidth, a default is used if not positive
+         */
+        auto init(float const multiplier, float const cpr,
+                  VelocityEstimator const estimator = VelocityEstimator::RUNNING_MEAN, float const bandwidth_hz = 0.0f) -> void {
             m_counts_unwrapped_prev = __HAL_TIM_GET_COUNTER(m_tick_timer);
             m_multiplier = multiplier;
             m_cpr = cpr;
+
+            m_estimator = estimator == VelocityEstimator::EDGE_TIMING && !m_timestamp_timer ? VelocityEstimator::RUNNING_MEAN : estimator;
+            m_velocity = 0.0f;
+            m_velocity_filter.clear();
+            if (m_timestamp_timer) {
+                float const tick_s = static_cast<float>(m_timestamp_timer->Instance->PSC + 1) / static_cast<float>(HAL_RCC_GetSysClockFreq());
+                m_edge_estimator = EdgeTimingEstimator{tick_s, EDGE_TIMEOUT_S};
+            }
+            m_tracking_estimator = TrackingLoopEstimator{bandwidth_hz > 0.0f ? bandwidth_hz : DEFAULT_TRACKING_BANDWIDTH_HZ};
+            // edge interrupts are only worth taking when something times them
+            set_capture(m_estimator == VelocityEstimator::EDGE_TIMING);
             m_initialized = true;
         }
 
+        /**
+         * Timestamp an encoder edge, call from the input capture interrupt of the encoder timer.
+         */
+        auto capture_edge() -> void {
+            if (!m_capture_en) return;
+            std::uint32_t const channel = m_tick_timer->Channel == HAL_TIM_ACTIVE_CHANNEL_1 ? TIM_CHANNEL_1 : TIM_CHANNEL_2;
+            m_edge.write({
+                    .ticks = static_cast<std::uint32_t>(__HAL_TIM_GET_COUNTER(m_timestamp_timer)),
+                    .count = static_cast<std::uint16_t>(HAL_TIM_ReadCapturedValue(m_tick_timer, channel)), // latched on the edge itself
+                    .valid = true,
+            });
+        }
+
         [[nodiscard]] auto read() const -> std::optional<EncoderReading> {
             if (!m_initialized) return std::nullopt;
             return std::make_optional(EncoderReading{
                     .position = m_position,
-                    .velocity = m_velocity_filter.get_filtered()});
+                    .velocity = m_velocity});
         }
 
         [[nodiscard]] auto get_delta_position() const -> float {
@@ -76,12 +170,27 @@ namespace mrover {
             m_delta_position = m_multiplier * static_cast<float>(delta_ticks) / m_cpr;
 
             m_position += m_delta_position;
-            m_velocity_filter.add_reading(m_delta_position / elapsed_time);
+            m_count += delta_ticks;
+
+            switch (m_estimator) {
+                case VelocityEstimator::RUNNING_MEAN:
+                    m_velocity_filter.add_reading(m_delta_position / elapsed_time);
+                    m_velocity = m_velocity_filter.get_filtered();
+                    break;
+                case VelocityEstimator::EDGE_TIMING:
+                    m_velocity = m_multiplier * estimate_from_edges() / m_cpr;
+                    break;
+                case VelocityEstimator::TRACKING_LOOP:
+                    m_velocity = m_multiplier * m_tracking_estimator.update(m_count, elapsed_time) / m_cpr;
+                    break;
+            }
         }
 
         auto expired() -> void {
             if (!m_initialized) return;
+            if (m_estimator != VelocityEstimator::RUNNING_MEAN) return;
             m_velocity_filter.add_reading(0.0f);
+            m_velocity = m_velocity_filter.get_filtered();
         }
     };
 #else  // HAL_TIM_MODULE_ENABLED
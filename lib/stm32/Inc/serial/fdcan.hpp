@@ -2,9 +2,11 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <optional>
 #include <serial/fdcan.hpp>
 #include <span>
 #include <string_view>
+#include <sys.hpp>
 #include <util.hpp>
 
 #ifdef STM32
@@ -15,6 +17,74 @@ namespace mrover {
 
     constexpr static std::size_t FDCAN_MAX_FRAME_SIZE = 64;
 
+    struct FDCANBitTiming {
+        uint32_t prescaler;
+        uint32_t sjw;
+        uint32_t seg1;
+        uint32_t seg2;
+    };
+
+    struct FDCANTimingProfile {
+        uint32_t kernel_clock;  // FDCAN kernel clock before the clock divider, hz
+        uint32_t clock_divider; // 1 or an even number up to 30
+        FDCANBitTiming nominal;
+        FDCANBitTiming data;
+        uint32_t tdc_offset; // secondary sample point at the data sample point, in kernel clock cycles
+    };
+
+    // deliberately not constexpr, calling it during constant evaluation fails compilation
+    auto fdcan_bitrate_unreachable() -> void;
+
+    /**
+     * \brief Pick the smallest prescaler which divides the clock into a whole number of time quanta per bit,
+     *        then place the sample point as close to the requested one (per mille of the bit time) as possible.
+     */
+    consteval auto compute_fdcan_bit_timing(uint32_t const clock, uint32_t const bitrate, uint32_t const sample_point,
+                                            uint32_t const max_prescaler, uint32_t const max_seg1, uint32_t const max_seg2, uint32_t const max_sjw) -> FDCANBitTiming {
+        for (uint32_t prescaler = 1; prescaler <= max_prescaler; ++prescaler) {
+            if (clock % (prescaler * bitrate) != 0) continue;
+
+            uint32_t const quanta = clock / (prescaler * bitrate);
+            uint32_t const seg1 = (quanta * sample_point + 500) / 1000 - 1; // sync segment is the first quantum
+            if (seg1 < 1 || seg1 >= quanta - 1) continue;
+            uint32_t const seg2 = quanta - 1 - seg1;
+            if (seg1 > max_seg1 || seg2 > max_seg2) continue;
+
+            return {.prescaler = prescaler, .sjw = std::min(seg2, max_sjw), .seg1 = seg1, .seg2 = seg2};
+        }
+        fdcan_bitrate_unreachable();
+        return {};
+    }
+
+    /**
+     * \brief Bit timing for a nominal/data bitrate pair, computed at compile time from the FDCAN kernel clock.
+     *        Defaults reproduce the CubeMX 1/5 Mbps setup on a 170 MHz kernel clock divided by 2.
+     */
+    consteval auto make_fdcan_timing_profile(uint32_t const kernel_clock, uint32_t const clock_divider,
+                                             uint32_t const nominal_bitrate, uint32_t const data_bitrate,
+                                             uint32_t const nominal_sample_point = 667, uint32_t const data_sample_point = 700) -> FDCANTimingProfile {
+        if (clock_divider != 1 && (clock_divider % 2 != 0 || clock_divider > 30)) fdcan_bitrate_unreachable();
+
+        uint32_t const clock = kernel_clock / clock_divider;
+        // SJW stays at the 16 CubeMX sets, a wider jump would tolerate oscillator drift no node on the bus has
+        FDCANBitTiming const nominal = compute_fdcan_bit_timing(clock, nominal_bitrate, nominal_sample_point, 512, 256, 128, 16);
+        // delay compensation only works with a data prescaler of 1 or 2
+        FDCANBitTiming const data = compute_fdcan_bit_timing(clock, data_bitrate, data_sample_point, 2, 32, 16, 16);
+        return {
+                .kernel_clock = kernel_clock,
+                .clock_divider = clock_divider,
+                .nominal = nominal,
+                .data = data,
+                .tdc_offset = data.prescaler * (data.seg1 + 1),
+        };
+    }
+
+    static_assert([] {
+        constexpr FDCANTimingProfile profile = make_fdcan_timing_profile(170'000'000, 2, 1'000'000, 5'000'000);
+        return profile.nominal.prescaler == 1 && profile.nominal.sjw == 16 && profile.nominal.seg1 == 56 && profile.nominal.seg2 == 28 &&
+               profile.data.prescaler == 1 && profile.data.sjw == 5 && profile.data.seg1 == 11 && profile.data.seg2 == 5;
+    }(), "the 1/5 Mbps profile no longer matches the CubeMX setup");
+
 #ifdef HAL_FDCAN_MODULE_ENABLED
     class FDCAN {
     public:
@@ -26,6 +96,7 @@ namespace mrover {
         enum class FilterAction {
             Accept,
             Reject,
+            Disable, // filter elements only, keeps its slot in message RAM without matching anything
         };
 
         enum class FilterMode {
@@ -34,6 +105,50 @@ namespace mrover {
             Mask,
         };
 
+        enum class RxFifo {
+            Fifo0,
+            Fifo1,
+        };
+
+        enum class ErrorState : uint8_t {
+            Active,
+            Warning, // an error counter reached 96
+            Passive, // an error counter reached 128
+            BusOff,  // tx error counter overflowed, the node is off the bus until recovered
+        };
+
+        struct BusHealth {
+            uint8_t tx_error_count;
+            uint8_t rx_error_count;
+            ErrorState error_state;
+            uint8_t last_error_code;      // FDCAN_PROTOCOL_ERROR_* in the arbitration phase
+            uint8_t data_last_error_code; // FDCAN_PROTOCOL_ERROR_* in the data phase
+            uint32_t bus_off_count;
+            uint32_t protocol_error_count;
+            uint32_t rx_overrun_count; // times an rx fifo filled up
+            uint32_t rx_lost_count;    // frames dropped because an rx fifo was full
+            uint32_t tx_dropped_count; // frames never queued, for bus-off or a tx fifo that stayed full
+
+            /**
+             * Pack into the generated ESWCANHealth message, which counts in 16 bits and so wraps sooner.
+             */
+            template<typename Message>
+            [[nodiscard]] auto to_message() const -> Message {
+                return Message{
+                        tx_error_count,
+                        rx_error_count,
+                        static_cast<uint8_t>(error_state),
+                        last_error_code,
+                        data_last_error_code,
+                        static_cast<uint16_t>(bus_off_count),
+                        static_cast<uint16_t>(protocol_error_count),
+                        static_cast<uint16_t>(rx_overrun_count),
+                        static_cast<uint16_t>(rx_lost_count),
+                        static_cast<uint16_t>(tx_dropped_count),
+                };
+            }
+        };
+
         struct Filter {
             uint32_t id1;
             uint32_t id2;
@@ -41,6 +156,7 @@ namespace mrover {
             FilterIdType id_type;
             FilterAction action;
             FilterMode mode;
+            RxFifo fifo = RxFifo::Fifo0; // destination of accepted frames
         };
 
         struct FilterConfig {
@@ -57,10 +173,26 @@ namespace mrover {
             // TODO: add more options to make this driver more configurable
             FilterConfig filter_config{};
 
+            // overrides the CubeMX bit timing, unset keeps it
+            std::optional<FDCANTimingProfile> bit_timing{};
+
             bool delay_compensation = false; // NOTE: needs to be on to enable BRS
             uint32_t tdc_offset = 0;         // 13 with moteus
             uint32_t tdc_filter = 0;         // 1 with moteus
 
+            // FIFO0 is served by interrupt line 0 and FIFO1 by interrupt line 1, so time-critical
+            // frames filtered into FIFO1 can preempt bulk traffic. unset keeps the CubeMX NVIC priority.
+            std::optional<uint32_t> fifo0_irq_priority{};
+            std::optional<uint32_t> fifo1_irq_priority{};
+
+            // internal timestamp counter ticks every N nominal bit times (1-16), unset leaves it stopped
+            std::optional<uint32_t> timestamp_prescaler{};
+            bool store_tx_events = false; // record tx complete timestamps in the tx event fifo
+
+            // bus-off recovery waits before restarting, doubling the wait on every bus-off in a streak
+            uint32_t bus_off_backoff_min_ms = 10;
+            uint32_t bus_off_backoff_max_ms = 1000;
+
             Options() {};
         };
 
@@ -72,6 +204,23 @@ namespace mrover {
         }
 
         auto init() -> void {
+            if (m_options.bit_timing) {
+                FDCANTimingProfile const& profile = *m_options.bit_timing;
+                // the profile was computed for a specific kernel clock, catch a clock tree that disagrees
+                check(HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN) == profile.kernel_clock, Error_Handler);
+
+                m_fdcan->Init.ClockDivider = profile.clock_divider == 1 ? FDCAN_CLOCK_DIV1 : profile.clock_divider / 2;
+                m_fdcan->Init.NominalPrescaler = profile.nominal.prescaler;
+                m_fdcan->Init.NominalSyncJumpWidth = profile.nominal.sjw;
+                m_fdcan->Init.NominalTimeSeg1 = profile.nominal.seg1;
+                m_fdcan->Init.NominalTimeSeg2 = profile.nominal.seg2;
+                m_fdcan->Init.DataPrescaler = profile.data.prescaler;
+                m_fdcan->Init.DataSyncJumpWidth = profile.data.sjw;
+                m_fdcan->Init.DataTimeSeg1 = profile.data.seg1;
+                m_fdcan->Init.DataTimeSeg2 = profile.data.seg2;
+                check(HAL_FDCAN_Init(m_fdcan) == HAL_OK, Error_Handler);
+            }
+
             if (m_options.delay_compensation) {
                 check(HAL_FDCAN_ConfigTxDelayCompensation(m_fdcan, m_options.tdc_offset, m_options.tdc_filter) == HAL_OK, Error_Handler);
                 check(HAL_FDCAN_EnableTxDelayCompensation(m_fdcan) == HAL_OK, Error_Handler);
@@ -79,8 +228,9 @@ namespace mrover {
                 check(HAL_FDCAN_DisableTxDelayCompensation(m_fdcan) == HAL_OK, Error_Handler);
             }
 
-            int std_filter_index = 0;
-            int ext_filter_index = 0;
+            uint32_t std_filter_index = 0;
+            uint32_t ext_filter_index = 0;
+            bool uses_fifo1 = false;
 
             FilterConfig const& filters = m_options.filter_config;
 
@@ -128,9 +278,12 @@ namespace mrover {
                               f.FilterConfig = [&]() -> uint32_t {
                                   switch (filter.action) {
                                       case FilterAction::Accept:
-                                          return FDCAN_FILTER_TO_RXFIFO0;
+                                          uses_fifo1 |= filter.fifo == RxFifo::Fifo1;
+                                          return filter.fifo == RxFifo::Fifo1 ? FDCAN_FILTER_TO_RXFIFO1 : FDCAN_FILTER_TO_RXFIFO0;
                                       case FilterAction::Reject:
                                           return FDCAN_FILTER_REJECT;
+                                      case FilterAction::Disable:
+                                          return FDCAN_FILTER_DISABLE;
                                   }
                                   Error_Handler();
                                   return FDCAN_FILTER_REJECT;
@@ -139,6 +292,8 @@ namespace mrover {
                               f.FilterID1 = filter.id1;
                               f.FilterID2 = filter.id2;
 
+                              // filter elements beyond what CubeMX allocated in message RAM are silently dropped
+                              check(std_filter_index <= m_fdcan->Init.StdFiltersNbr && ext_filter_index <= m_fdcan->Init.ExtFiltersNbr, Error_Handler);
                               check(HAL_FDCAN_ConfigFilter(m_fdcan, &f) == HAL_OK, Error_Handler);
                           });
 
@@ -150,6 +305,8 @@ namespace mrover {
                     case FilterAction::Reject: {
                         return FDCAN_REJECT;
                     }
+                    case FilterAction::Disable:
+                        break;
                 }
                 Error_Handler();
                 return FDCAN_REJECT;
@@ -163,6 +320,8 @@ namespace mrover {
                     case FilterAction::Reject: {
                         return FDCAN_REJECT_REMOTE;
                     }
+                    case FilterAction::Disable:
+                        break;
                 }
                 Error_Handler();
                 return FDCAN_REJECT_REMOTE;
@@ -175,26 +334,154 @@ namespace mrover {
                                                map_remote_action(filters.global_remote_ext_action)) == HAL_OK,
                   Error_Handler);
 
-            check(HAL_FDCAN_ActivateNotification(m_fdcan, FDCAN_IT_RX_FIFO0_NEW_MESSAGE, 0) == HAL_OK, Error_Handler);
+            // keep each fifo on its own interrupt line so they can be prioritized independently
+            check(HAL_FDCAN_ConfigInterruptLines(m_fdcan, FDCAN_IT_GROUP_RX_FIFO0, FDCAN_INTERRUPT_LINE0) == HAL_OK, Error_Handler);
+            check(HAL_FDCAN_ConfigInterruptLines(m_fdcan, FDCAN_IT_GROUP_RX_FIFO1, FDCAN_INTERRUPT_LINE1) == HAL_OK, Error_Handler);
+            if (m_options.fifo0_irq_priority) {
+                HAL_NVIC_SetPriority(line_irqn(FDCAN_INTERRUPT_LINE0), *m_options.fifo0_irq_priority, 0);
+            }
+            if (m_options.fifo1_irq_priority) {
+                HAL_NVIC_SetPriority(line_irqn(FDCAN_INTERRUPT_LINE1), *m_options.fifo1_irq_priority, 0);
+            }
+
+            if (m_options.timestamp_prescaler) {
+                uint32_t const prescaler = *m_options.timestamp_prescaler;
+                check(prescaler >= 1 && prescaler <= 16, Error_Handler);
+                check(HAL_FDCAN_ConfigTimestampCounter(m_fdcan, (prescaler - 1) << FDCAN_TSCC_TCP_Pos) == HAL_OK, Error_Handler);
+                check(HAL_FDCAN_EnableTimestampCounter(m_fdcan, FDCAN_TIMESTAMP_INTERNAL) == HAL_OK, Error_Handler);
+                m_timestamp_tick_ns = nominal_bit_time_ns() * prescaler;
+            }
+
+            m_bus_off_backoff_ms = m_options.bus_off_backoff_min_ms;
+
+            check(HAL_FDCAN_ActivateNotification(m_fdcan, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO0_FULL | FDCAN_IT_RX_FIFO0_MESSAGE_LOST, 0) == HAL_OK, Error_Handler);
+            if (uses_fifo1) {
+                check(HAL_FDCAN_ActivateNotification(m_fdcan, FDCAN_IT_RX_FIFO1_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_FULL | FDCAN_IT_RX_FIFO1_MESSAGE_LOST, 0) == HAL_OK, Error_Handler);
+            }
+            // protocol errors are not interrupt driven, a noisy bus would flood the cpu; the error logging counter covers them
+            check(HAL_FDCAN_ActivateNotification(m_fdcan, FDCAN_IT_BUS_OFF, 0) == HAL_OK, Error_Handler);
             check(HAL_FDCAN_Start(m_fdcan) == HAL_OK, Error_Handler);
         }
 
         /**
-         * \brief   Attempt to pop a message from the receive queue
+         * \brief   Account for rx fifo status interrupts, call from HAL_FDCAN_RxFifo0Callback/HAL_FDCAN_RxFifo1Callback
+         */
+        auto handle_rx_fifo_status(RxFifo const fifo, uint32_t const fifo_its) -> void {
+            uint32_t const full = fifo == RxFifo::Fifo1 ? FDCAN_IT_RX_FIFO1_FULL : FDCAN_IT_RX_FIFO0_FULL;
+            uint32_t const lost = fifo == RxFifo::Fifo1 ? FDCAN_IT_RX_FIFO1_MESSAGE_LOST : FDCAN_IT_RX_FIFO0_MESSAGE_LOST;
+            if (fifo_its & full) ++m_rx_overrun_count;
+            if (fifo_its & lost) ++m_rx_lost_count;
+        }
+
+        /**
+         * \brief   Schedule bus-off recovery, call from HAL_FDCAN_ErrorStatusCallback
+         */
+        auto handle_error_status(uint32_t const error_status_its) -> void {
+            if (!(error_status_its & FDCAN_IT_BUS_OFF)) return;
+
+            // the interrupt fires on every bus-off status change, including leaving it
+            FDCAN_ProtocolStatusTypeDef status;
+            if (HAL_FDCAN_GetProtocolStatus(m_fdcan, &status) != HAL_OK || !status.BusOff) return;
+            latch_error_codes(status);
+
+            ++m_bus_off_count;
+            m_recovery_tick = HAL_GetTick() + m_bus_off_backoff_ms;
+            m_recovery_pending = true;
+            m_bus_off_backoff_ms = std::min<uint32_t>(m_bus_off_backoff_ms * 2, m_options.bus_off_backoff_max_ms);
+        }
+
+        /**
+         * \brief   Restart the controller once a scheduled bus-off recovery is due, call periodically outside of interrupts
+         * \note    After the restart the controller still waits for 128 occurrences of 11 recessive bits before joining the bus
+         */
+        auto update_recovery() -> void {
+            uint32_t const now = HAL_GetTick();
+            if (m_recovery_pending) {
+                if (static_cast<int32_t>(now - m_recovery_tick) < 0) return;
+                m_recovery_pending = false;
+                m_last_recovery_tick = now;
+                reset();
+            } else if (now - m_last_recovery_tick >= m_options.bus_off_backoff_max_ms) {
+                // stayed on the bus for a full max backoff, the streak is over
+                m_bus_off_backoff_ms = m_options.bus_off_backoff_min_ms;
+            }
+        }
+
+        /**
+         * \brief   Snapshot of the bus error state and the error statistics since init
+         */
+        [[nodiscard]] auto health() -> BusHealth {
+            FDCAN_ErrorCountersTypeDef counters{};
+            HAL_FDCAN_GetErrorCounters(m_fdcan, &counters);
+            FDCAN_ProtocolStatusTypeDef status{};
+            HAL_FDCAN_GetProtocolStatus(m_fdcan, &status);
+            latch_error_codes(status);
+            // the error logging counter clears on read
+            m_protocol_error_count += counters.ErrorLogging;
+
+            return {
+                    .tx_error_count = static_cast<uint8_t>(counters.TxErrorCnt),
+                    .rx_error_count = static_cast<uint8_t>(counters.RxErrorPassive ? 128 : counters.RxErrorCnt),
+                    .error_state = status.BusOff         ? ErrorState::BusOff
+                                   : status.ErrorPassive ? ErrorState::Passive
+                                   : status.Warning      ? ErrorState::Warning
+                                                         : ErrorState::Active,
+                    .last_error_code = m_last_error_code,
+                    .data_last_error_code = m_data_last_error_code,
+                    .bus_off_count = m_bus_off_count,
+                    .protocol_error_count = m_protocol_error_count,
+                    .rx_overrun_count = m_rx_overrun_count,
+                    .rx_lost_count = m_rx_lost_count,
+                    .tx_dropped_count = m_tx_dropped_count,
+            };
+        }
+
+        /**
+         * \brief   Attempt to pop a message from a receive queue
+         * \param   fifo Receive FIFO to pop from
          * \return  True if message received from queue, false otherwise
+         * \note    header->RxTimestamp holds the timestamp counter value captured at start of frame
          */
-        [[nodiscard]] auto receive(FDCAN_RxHeaderTypeDef* header, std::span<uint8_t> data) const -> bool {
-            if (HAL_FDCAN_GetRxFifoFillLevel(m_fdcan, FDCAN_RX_FIFO0) == 0)
+        [[nodiscard]] auto receive(FDCAN_RxHeaderTypeDef* header, std::span<uint8_t> data, RxFifo const fifo = RxFifo::Fifo0) const -> bool {
+            if (HAL_FDCAN_GetRxFifoFillLevel(m_fdcan, to_hal_fifo(fifo)) == 0)
                 return false;
 
-            if (HAL_FDCAN_GetRxMessage(m_fdcan, FDCAN_RX_FIFO0, header, data.data()) != HAL_OK) {
+            if (HAL_FDCAN_GetRxMessage(m_fdcan, to_hal_fifo(fifo), header, data.data()) != HAL_OK) {
                 return false;
             }
+            System::note_can_id(header->Identifier);
             return true;
         }
 
-        auto messages_to_process() const -> uint32_t {
-            return HAL_FDCAN_GetRxFifoFillLevel(m_fdcan, FDCAN_RX_FIFO0);
+        auto messages_to_process(RxFifo const fifo = RxFifo::Fifo0) const -> uint32_t {
+            return HAL_FDCAN_GetRxFifoFillLevel(m_fdcan, to_hal_fifo(fifo));
+        }
+
+        /**
+         * \brief   Attempt to pop a transmit complete event
+         * \return  True if an event was popped, event->TxTimestamp and event->MessageMarker are then valid
+         * \note    Only populated when Options::store_tx_events is set, the fifo holds 3 events and drops newer ones when full
+         */
+        [[nodiscard]] auto receive_tx_event(FDCAN_TxEventFifoTypeDef* event) const -> bool {
+            return HAL_FDCAN_GetTxEvent(m_fdcan, event) == HAL_OK;
+        }
+
+        /**
+         * \brief   Current value of the 16-bit timestamp counter, same timebase as rx/tx event timestamps
+         */
+        [[nodiscard]] auto timestamp() const -> uint16_t {
+            return HAL_FDCAN_GetTimestampCounter(m_fdcan);
+        }
+
+        /**
+         * \brief   Time elapsed since a timestamp, valid as long as less than one counter wrap has passed
+         */
+        [[nodiscard]] auto timestamp_elapsed_ns(uint16_t const since) const -> uint32_t {
+            return static_cast<uint16_t>(timestamp() - since) * m_timestamp_tick_ns;
+        }
+
+        [[nodiscard]] auto timestamp_tick_ns() const -> uint32_t {
+            return m_timestamp_tick_ns;
         }
 
         /**
@@ -220,9 +507,32 @@ namespace mrover {
             return 0;
         }
 
-        void send(uint32_t const id, std::string_view const data) {
-            if (m_last_tx_request) {
-                HAL_FDCAN_AbortTxRequest(m_fdcan, m_last_tx_request);
+        /**
+         * \return  Message marker of the frame, reported back in its tx event, or nothing if the frame was dropped
+         * \note    Frames are dropped while bus-off, and when the tx fifo is full: at once from an interrupt,
+         *          after a few frame times otherwise. Dropped frames are counted in health()
+         */
+        auto send(uint32_t const id, std::string_view const data) -> std::optional<uint8_t> {
+            // the tx fifo cannot drain while bus-off, drop frames until recovered
+            if (m_recovery_pending) {
+                ++m_tx_dropped_count;
+                return std::nullopt;
+            }
+
+            // a burst can outrun the bus, so outside of interrupts give the frames ahead a few frame times to go out.
+            // Still full means nothing acknowledges the oldest, which is aborted to make room for the next send
+            if (HAL_FDCAN_GetTxFifoFreeLevel(m_fdcan) == 0 && !System::in_interrupt()) {
+                uint32_t const start = System::get_cycles();
+                uint32_t const timeout = TX_FULL_WAIT_US * (SystemCoreClock / 1000000U);
+                while (HAL_FDCAN_GetTxFifoFreeLevel(m_fdcan) == 0 && System::get_cycles() - start < timeout) {}
+                if (HAL_FDCAN_GetTxFifoFreeLevel(m_fdcan) == 0) {
+                    uint32_t const oldest = (m_fdcan->Instance->TXFQS & FDCAN_TXFQS_TFGI) >> FDCAN_TXFQS_TFGI_Pos;
+                    HAL_FDCAN_AbortTxRequest(m_fdcan, 1U << oldest);
+                }
+            }
+            if (HAL_FDCAN_GetTxFifoFreeLevel(m_fdcan) == 0) {
+                ++m_tx_dropped_count;
+                return std::nullopt;
             }
 
             FDCAN_TxHeaderTypeDef const header{
@@ -233,14 +543,16 @@ namespace mrover {
                     .ErrorStateIndicator = FDCAN_ESI_ACTIVE,
                     .BitRateSwitch = FDCAN_BRS_ON,
                     .FDFormat = FDCAN_FD_CAN,
-                    .TxEventFifoControl = FDCAN_NO_TX_EVENTS,
+                    .TxEventFifoControl = m_options.store_tx_events ? FDCAN_STORE_TX_EVENTS : FDCAN_NO_TX_EVENTS,
+                    .MessageMarker = m_tx_marker,
             };
 
             if (HAL_FDCAN_AddMessageToTxFifoQ(m_fdcan, &header, const_cast<uint8_t*>(reinterpret_cast<uint8_t const*>(data.data()))) != HAL_OK) {
-                Error_Handler();
+                ++m_tx_dropped_count;
+                return std::nullopt;
             }
 
-            m_last_tx_request = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(m_fdcan);
+            return m_tx_marker++;
         }
 
         auto reset() const -> void {
@@ -249,9 +561,51 @@ namespace mrover {
         }
 
     private:
+        // a handful of 64 byte frames at the data rate, longer means nobody is acknowledging
+        static constexpr uint32_t TX_FULL_WAIT_US = 500;
+
         FDCAN_HandleTypeDef* m_fdcan{};
         Options m_options{};
-        uint32_t m_last_tx_request = 0;
+        uint32_t m_timestamp_tick_ns = 0;
+        uint8_t m_tx_marker = 0;
+
+        // bus health, counters are updated from interrupts
+        uint32_t volatile m_bus_off_count = 0;
+        uint32_t volatile m_rx_overrun_count = 0;
+        uint32_t volatile m_rx_lost_count = 0;
+        uint32_t volatile m_tx_dropped_count = 0;
+        uint32_t m_protocol_error_count = 0;
+        uint8_t m_last_error_code = FDCAN_PROTOCOL_ERROR_NONE;
+        uint8_t m_data_last_error_code = FDCAN_PROTOCOL_ERROR_NONE;
+        bool volatile m_recovery_pending = false;
+        uint32_t volatile m_recovery_tick = 0;
+        uint32_t m_last_recovery_tick = 0;
+        uint32_t volatile m_bus_off_backoff_ms = 0;
+
+        // reading the protocol status resets the error codes to "no change", keep the last real one
+        auto latch_error_codes(FDCAN_ProtocolStatusTypeDef const& status) -> void {
+            if (status.LastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE) m_last_error_code = status.LastErrorCode;
+            if (status.DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE) m_data_last_error_code = status.DataLastErrorCode;
+        }
+
+        constexpr static auto to_hal_fifo(RxFifo const fifo) -> uint32_t {
+            return fifo == RxFifo::Fifo1 ? FDCAN_RX_FIFO1 : FDCAN_RX_FIFO0;
+        }
+
+        [[nodiscard]] auto nominal_bit_time_ns() const -> uint32_t {
+            // FDCAN_CLOCK_DIVn is encoded as n / 2 for every divider above 1
+            uint64_t const divider = m_fdcan->Init.ClockDivider == FDCAN_CLOCK_DIV1 ? 1 : 2 * m_fdcan->Init.ClockDivider;
+            uint64_t const quanta = 1 + m_fdcan->Init.NominalTimeSeg1 + m_fdcan->Init.NominalTimeSeg2;
+            uint64_t const kernel_hz = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN);
+            return static_cast<uint32_t>(1'000'000'000ULL * divider * m_fdcan->Init.NominalPrescaler * quanta / kernel_hz);
+        }
+
+        [[nodiscard]] auto line_irqn(uint32_t const line) const -> IRQn_Type {
+#ifdef FDCAN2
+            if (m_fdcan->Instance == FDCAN2) return line == FDCAN_INTERRUPT_LINE0 ? FDCAN2_IT0_IRQn : FDCAN2_IT1_IRQn;
+#endif // FDCAN2
+            return line == FDCAN_INTERRUPT_LINE0 ? FDCAN1_IT0_IRQn : FDCAN1_IT1_IRQn;
+        }
     };
 #else  // HAL_FDCAN_MODULE_ENABLED
     class __attribute__((unavailable("enable 'FDCAN' in STM32CubeMX to use mrover::FDCAN"))) FDCAN {
@@ -1,19 +1,275 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
 #ifdef STM32
 #include "main.h"
 #endif // STM32
 
+/**
+ * Run a function from CCM SRAM instead of flash.
+ * CCM SRAM sits on the instruction bus with no wait states and is not stalled by flash erase or program,
+ * the startup code copies the .ccmram section out of flash before main.
+ * Calls between flash and CCM SRAM are out of direct branch range, hence long_call.
+ * Define MROVER_NO_RAMFUNC to build everything from flash, e.g. to compare cycle counts.
+ */
+#ifndef MROVER_NO_RAMFUNC
+#define MROVER_RAMFUNC __attribute__((section(".ccmram.text"), noinline, long_call))
+#else
+#define MROVER_RAMFUNC
+#endif // MROVER_NO_RAMFUNC
+
+// vector table in flash from the startup file, and its copy in CCM SRAM from the linker script
+extern "C" uint32_t const g_pfnVectors[];
+extern "C" uint32_t _sccmram_vectors[];
+extern "C" uint32_t _eccmram_vectors[];
+
+// heap start and end of RAM from the linker script, heap statistics from _sbrk in sysmem.c
+extern "C" uint8_t _end;
+extern "C" uint8_t _estack;
+extern "C" void _sbrk_stats(uint8_t** heap_end, uint32_t* failures);
+
 namespace mrover {
 
+    // timing of one instrumented task over a report window
+    struct TaskStats {
+        static constexpr std::size_t HISTOGRAM_BINS = 16;
+        // bin 0 holds durations below 2^7 cycles, each bin above doubles, the last one is open ended
+        static constexpr int HISTOGRAM_FIRST_BIT = 7;
+
+        uint32_t count{};
+        uint32_t min_cycles{};
+        uint32_t max_cycles{};
+        uint64_t total_cycles{};
+        uint32_t max_latency_cycles{};
+        std::array<uint16_t, HISTOGRAM_BINS> histogram{};
+
+        [[nodiscard]] auto avg_cycles() const -> uint32_t {
+            return count ? static_cast<uint32_t>(total_cycles / count) : 0;
+        }
+    };
+
+    // idle and worst ISR timing over a report window
+    struct CpuLoad {
+        uint32_t window_cycles{};
+        uint32_t idle_cycles{};
+        uint32_t max_isr_latency_cycles{};
+        uint32_t max_isr_cycles{};
+
+        // busy time in hundredths of a percent
+        [[nodiscard]] auto cpu_load() const -> uint16_t {
+            if (window_cycles == 0) return 0;
+            uint32_t const idle = std::min(idle_cycles, window_cycles);
+            return static_cast<uint16_t>(10000 - static_cast<uint64_t>(idle) * 10000 / window_cycles);
+        }
+    };
+
+    /**
+     * Fault state kept in RAM the startup code does not touch, so it survives the reset that follows a fault.
+     * The CAN history is filled all the time, the rest is written when the fault happens.
+     */
+    struct CrashRecord {
+        static constexpr uint32_t MAGIC = 0x48535243; // "CRSH"
+        static constexpr std::size_t CAN_HISTORY = 8;
+
+        uint32_t magic;
+        uint32_t reason;
+        uint32_t pc;
+        uint32_t lr;
+        uint32_t psr;
+        uint32_t cfsr;
+        uint32_t hfsr;
+        uint32_t bfar;
+        uint32_t uptime_ms;
+        std::array<uint32_t, CAN_HISTORY> can_ids;
+        uint32_t can_head;
+        uint32_t checksum;
+
+        [[nodiscard]] auto compute_checksum() const -> uint32_t {
+            auto const* words = reinterpret_cast<uint32_t const*>(this);
+            uint32_t sum = 0;
+            for (std::size_t i = 0; i < offsetof(CrashRecord, checksum) / sizeof(uint32_t); ++i) {
+                sum = (sum << 1 | sum >> 31) ^ words[i];
+            }
+            return ~sum;
+        }
+
+        [[nodiscard]] auto valid() const -> bool {
+            return magic == MAGIC && checksum == compute_checksum();
+        }
+
+        // i-th most recently received CAN identifier
+        [[nodiscard]] auto can_id(std::size_t const i) const -> uint32_t {
+            return can_ids[(can_head + CAN_HISTORY - 1 - i) % CAN_HISTORY];
+        }
+    };
+
+    /**
+     * Cycle accurate CPU load, ISR latency and task timing built on the DWT cycle counter.
+     *
+     * Tasks (main loop passes, ISR callbacks...) are numbered by each board and timed with Scope.
+     * Per task the count, min/avg/max duration, worst entry latency and a log2 duration histogram are kept
+     * for the current report window, which take_task() reads out and restarts.
+     * Idle time is what System::wfi() spends asleep, minus the time spent in instrumented ISRs on wake up.
+     *
+     * Everything compiles to nothing unless MROVER_INSTRUMENTATION is defined.
+     */
+    class Instrumentation {
+    public:
+#ifdef MROVER_INSTRUMENTATION
+        static constexpr bool ENABLED = true;
+#else
+        static constexpr bool ENABLED = false;
+#endif // MROVER_INSTRUMENTATION
+
+        static constexpr std::size_t MAX_TASKS = 8;
+
+        /**
+         * Times the enclosing block as a task, e.g. the body of an interrupt callback.
+         */
+        class Scope {
+        public:
+            explicit Scope(uint8_t const task, uint32_t const latency_cycles = 0, bool const isr = false)
+                : m_start{now()}, m_latency{latency_cycles}, m_task{task}, m_isr{isr} {}
+
+            ~Scope() {
+                record(m_task, now() - m_start, m_latency, m_isr);
+            }
+
+            Scope(Scope const&) = delete;
+            auto operator=(Scope const&) -> Scope& = delete;
+            Scope(Scope&&) = delete;
+            auto operator=(Scope&&) -> Scope& = delete;
+
+        private:
+            uint32_t m_start;
+            uint32_t m_latency;
+            uint8_t m_task;
+            bool m_isr;
+        };
+
+        // cycle counter, zero when compiled out so callers timing a task cost nothing
+        static auto now() -> uint32_t {
+            if constexpr (!ENABLED) return 0;
+            return DWT->CYCCNT;
+        }
+
+        // cycles since the update event of an up counting timer, its entry latency when called first thing in the callback
+        static auto timer_latency(TIM_HandleTypeDef const* htim) -> uint32_t {
+            if constexpr (!ENABLED) return 0;
+            return htim->Instance->CNT * (htim->Instance->PSC + 1);
+        }
+
+        static auto record([[maybe_unused]] uint8_t const task, [[maybe_unused]] uint32_t const cycles,
+                           [[maybe_unused]] uint32_t const latency_cycles = 0, [[maybe_unused]] bool const isr = false) -> void {
+#ifdef MROVER_INSTRUMENTATION
+            if (task >= MAX_TASKS) return;
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            TaskStats& stats = s_tasks[task];
+            if (stats.count == 0 || cycles < stats.min_cycles) stats.min_cycles = cycles;
+            stats.max_cycles = std::max(stats.max_cycles, cycles);
+            stats.max_latency_cycles = std::max(stats.max_latency_cycles, latency_cycles);
+            stats.total_cycles += cycles;
+            ++stats.count;
+            std::size_t const bin = std::clamp(static_cast<int>(std::bit_width(cycles)) - TaskStats::HISTOGRAM_FIRST_BIT, 0, static_cast<int>(TaskStats::HISTOGRAM_BINS) - 1);
+            if (stats.histogram[bin] != UINT16_MAX) ++stats.histogram[bin];
+            if (isr) {
+                s_isr_cycles = s_isr_cycles + cycles;
+                s_max_isr_latency_cycles = std::max(s_max_isr_latency_cycles, latency_cycles);
+                s_max_isr_cycles = std::max(s_max_isr_cycles, cycles);
+            }
+            __set_PRIMASK(primask);
+#endif // MROVER_INSTRUMENTATION
+        }
+
+        // total cycles spent in instrumented ISRs, wraps
+        static auto isr_cycles() -> uint32_t {
+#ifdef MROVER_INSTRUMENTATION
+            return s_isr_cycles;
+#else
+            return 0;
+#endif // MROVER_INSTRUMENTATION
+        }
+
+        static auto add_idle([[maybe_unused]] uint32_t const cycles) -> void {
+#ifdef MROVER_INSTRUMENTATION
+            s_idle_cycles += cycles;
+#endif // MROVER_INSTRUMENTATION
+        }
+
+        /**
+         * CPU load and worst ISR timing since the last call.
+         */
+        static auto take_load() -> CpuLoad {
+#ifdef MROVER_INSTRUMENTATION
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            uint32_t const cycles = DWT->CYCCNT;
+            CpuLoad const load{cycles - s_window_start, s_idle_cycles, s_max_isr_latency_cycles, s_max_isr_cycles};
+            s_window_start = cycles;
+            s_idle_cycles = 0;
+            s_max_isr_latency_cycles = 0;
+            s_max_isr_cycles = 0;
+            __set_PRIMASK(primask);
+            return load;
+#else
+            return {};
+#endif // MROVER_INSTRUMENTATION
+        }
+
+        /**
+         * Statistics of a task since the last call.
+         */
+        static auto take_task([[maybe_unused]] uint8_t const task) -> TaskStats {
+#ifdef MROVER_INSTRUMENTATION
+            if (task >= MAX_TASKS) return {};
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            TaskStats const stats = s_tasks[task];
+            s_tasks[task] = {};
+            __set_PRIMASK(primask);
+            return stats;
+#else
+            return {};
+#endif // MROVER_INSTRUMENTATION
+        }
+
+#ifdef MROVER_INSTRUMENTATION
+    private:
+        static inline std::array<TaskStats, MAX_TASKS> s_tasks{};
+        static inline uint32_t volatile s_isr_cycles{};
+        static inline uint32_t s_idle_cycles{};
+        static inline uint32_t s_max_isr_latency_cycles{};
+        static inline uint32_t s_max_isr_cycles{};
+        static inline uint32_t s_window_start{};
+#endif // MROVER_INSTRUMENTATION
+    };
+
     class System {
     public:
         struct options_t {
             options_t() {}
             bool sleep_on_wfi{true};
             bool enable_debug_sleep{true};
+            bool ram_vector_table{true};
+        };
+
+        struct MemoryUsage {
+            uint32_t stack_peak{};    // deepest main stack use since reset, in bytes
+            uint32_t stack_free{};    // bytes never touched between the heap end and the deepest stack use
+            uint32_t heap_used{};     // bytes handed out by _sbrk
+            uint32_t heap_failures{}; // allocations refused by _sbrk
         };
 
+        // fill word written by the startup code between the heap start and the stack
+        static constexpr uint32_t STACK_PAINT = 0xC5C5C5C5;
+
         enum class fault_reason_t {
             UNKNOWN_ERROR = 0,
             HALT_ERROR,
@@ -39,6 +295,45 @@ namespace mrover {
             CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
             DWT->CYCCNT = 0;
             DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+            start_cycles64();
+
+            if (m_options.ram_vector_table) {
+                relocate_vector_table();
+            }
+
+            // keep the record of a fault before this reset, then start a fresh one
+            if (s_crash_record.valid()) {
+                s_last_crash = s_crash_record;
+            }
+            s_crash_record.magic = 0;
+            s_crash_record.can_ids = {};
+            s_crash_record.can_head = 0;
+        }
+
+        // fault that caused the last reset, if it was one
+        static auto last_crash() -> std::optional<CrashRecord> const& {
+            return s_last_crash;
+        }
+
+        // remember a received CAN identifier for the crash record
+        static auto note_can_id(uint32_t const id) -> void {
+            s_crash_record.can_ids[s_crash_record.can_head++ % CrashRecord::CAN_HISTORY] = id;
+        }
+
+        // vector fetches then come from CCM SRAM, so taking an interrupt never waits on flash
+        static auto relocate_vector_table() -> void {
+            // boards that keep RAM contiguous reserve no copy in their linker script
+            std::ptrdiff_t const size = _eccmram_vectors - _sccmram_vectors;
+            if (size == 0) return;
+
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            std::copy(g_pfnVectors, g_pfnVectors + size, _sccmram_vectors);
+            __DSB();
+            SCB->VTOR = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(_sccmram_vectors));
+            __DSB();
+            __ISB();
+            __set_PRIMASK(primask);
         }
 
         static auto reset() -> void {
@@ -48,11 +343,17 @@ namespace mrover {
 
         // Wait For Interrupt
         auto wfi() const -> void {
+            uint32_t const start = Instrumentation::now();
+            uint32_t const isr_start = Instrumentation::isr_cycles();
             if (m_options.sleep_on_wfi) {
                 HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
             } else {
                 __WFI();
             }
+            // the interrupt that woke the core has already run, that part was not idle
+            if constexpr (Instrumentation::ENABLED) {
+                Instrumentation::add_idle(Instrumentation::now() - start - (Instrumentation::isr_cycles() - isr_start));
+            }
         }
 
         // Data Synchronization Barrier
@@ -69,10 +370,37 @@ namespace mrover {
             return HAL_GetTick();
         }
 
+        static auto get_cycles() -> uint32_t {
+            return DWT->CYCCNT;
+        }
+
         static auto get_micros() -> uint32_t {
             return DWT->CYCCNT / (SystemCoreClock / 1000000U);
         }
 
+        // 64-bit extension of the DWT cycle counter, safe to call from interrupts.
+        // CYCCNT wraps every ~25 s at 170 MHz, so this must be called at least that often,
+        // boards reading it call it from SysTick to never miss a wrap however rarely they read it themselves
+        static auto get_cycles64() -> uint64_t {
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            uint32_t const cycles = DWT->CYCCNT;
+            // SysTick runs before init zeroes the counter, so extending only starts from the value init seeds
+            if (!s_cycles_started) {
+                __set_PRIMASK(primask);
+                return cycles;
+            }
+            if (cycles < s_last_cycles) ++s_cycle_wraps;
+            s_last_cycles = cycles;
+            uint64_t const result = (static_cast<uint64_t>(s_cycle_wraps) << 32) | cycles;
+            __set_PRIMASK(primask);
+            return result;
+        }
+
+        static auto get_micros64() -> uint64_t {
+            return get_cycles64() / (SystemCoreClock / 1000000U);
+        }
+
         static auto delay_ms(uint32_t const ms) -> void {
             HAL_Delay(ms);
         }
@@ -85,56 +413,111 @@ namespace mrover {
             __enable_irq();
         }
 
+        [[nodiscard]] static auto in_interrupt() -> bool {
+            return __get_IPSR() != 0;
+        }
+
+        // restores the interrupt mask it found, so guards nest
         class InterruptGuard {
         public:
-            InterruptGuard() { disable_interrupts(); }
-            ~InterruptGuard() { enable_interrupts(); }
+            InterruptGuard() : m_primask{__get_PRIMASK()} { disable_interrupts(); }
+            ~InterruptGuard() { __set_PRIMASK(m_primask); }
 
             InterruptGuard(InterruptGuard const&) = delete;
             auto operator=(InterruptGuard const&) -> InterruptGuard& = delete;
             InterruptGuard(InterruptGuard&&) = delete;
             auto operator=(InterruptGuard&&) -> InterruptGuard& = delete;
+
+        private:
+            uint32_t m_primask;
         };
 
+        /**
+         * Stack and heap high-water marks.
+         * The stack grows down into painted RAM, the first word above the heap that is no longer painted
+         * is the deepest the stack has been. Scans the free RAM, so only call this at a low rate.
+         */
+        static auto memory_usage() -> MemoryUsage {
+            uint8_t* heap_end;
+            uint32_t heap_failures;
+            _sbrk_stats(&heap_end, &heap_failures);
+
+            auto const* word = reinterpret_cast<uint32_t const*>((reinterpret_cast<uintptr_t>(heap_end) + 3) & ~uintptr_t{3});
+            auto const* const stack_top = reinterpret_cast<uint32_t const*>(&_estack);
+            while (word < stack_top && *word == STACK_PAINT) ++word;
+
+            auto const stack_low = reinterpret_cast<uintptr_t>(word);
+            return {
+                    static_cast<uint32_t>(reinterpret_cast<uintptr_t>(stack_top) - stack_low),
+                    static_cast<uint32_t>(stack_low - reinterpret_cast<uintptr_t>(heap_end)),
+                    static_cast<uint32_t>(heap_end - &_end),
+                    heap_failures,
+            };
+        }
+
         static auto get_unique_id() -> uint32_t* {
             return reinterpret_cast<uint32_t*>(UID_BASE);
         }
 
         [[noreturn]] static auto fault(fault_reason_t reason = fault_reason_t::UNKNOWN_ERROR) -> void {
             disable_interrupts();
-
-            // TODO(eric): store fail state to SRAM here
-
-            for (;;) {
-                __NOP();
-            }
+            save_crash(reason, 0, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__builtin_return_address(0))), __get_xPSR());
+            halt();
         }
 
+        /**
+         * Record a hard fault from the exception frame stacked on entry to the handler.
+         * @param fault_stack_address r0, r1, r2, r3, r12, lr, pc and xpsr at the time of the fault
+         */
         [[noreturn]] static auto handle_hard_fault(uint32_t const* fault_stack_address) -> void {
-            uint32_t const volatile r0 = fault_stack_address[0];
-            uint32_t const volatile r1 = fault_stack_address[1];
-            uint32_t const volatile r2 = fault_stack_address[2];
-            uint32_t const volatile r3 = fault_stack_address[3];
-            uint32_t const volatile r12 = fault_stack_address[4];
-            uint32_t const volatile lr = fault_stack_address[5];
-            uint32_t const volatile pc = fault_stack_address[6]; // PC (on crash)
-            uint32_t const volatile psr = fault_stack_address[7];
-
-            (void) r0;
-            (void) r1;
-            (void) r2;
-            (void) r3;
-            (void) r12;
-            (void) lr;
-            (void) pc;
-            (void) psr;
-
-            fault(fault_reason_t::HARD_FAULT);
+            disable_interrupts();
+            save_crash(fault_reason_t::HARD_FAULT, fault_stack_address[6], fault_stack_address[5], fault_stack_address[7]);
+            halt();
         }
 
     private:
         options_t m_options{};
 
+        static inline uint32_t s_last_cycles{};
+        static inline uint32_t s_cycle_wraps{};
+        static inline bool s_cycles_started{};
+
+        static inline CrashRecord s_crash_record __attribute__((section(".noinit")));
+        static inline std::optional<CrashRecord> s_last_crash{};
+
+        // seed the 64-bit extension from the counter init just zeroed
+        static auto start_cycles64() -> void {
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            s_last_cycles = DWT->CYCCNT;
+            s_cycle_wraps = 0;
+            s_cycles_started = true;
+            __set_PRIMASK(primask);
+        }
+
+        static auto save_crash(fault_reason_t const reason, uint32_t const pc, uint32_t const lr, uint32_t const psr) -> void {
+            s_crash_record.magic = CrashRecord::MAGIC;
+            s_crash_record.reason = static_cast<uint32_t>(reason);
+            s_crash_record.pc = pc;
+            s_crash_record.lr = lr;
+            s_crash_record.psr = psr;
+            s_crash_record.cfsr = SCB->CFSR;
+            s_crash_record.hfsr = SCB->HFSR;
+            s_crash_record.bfar = SCB->BFAR;
+            s_crash_record.uptime_ms = HAL_GetTick();
+            s_crash_record.checksum = s_crash_record.compute_checksum();
+        }
+
+        // stay put for an attached debugger, otherwise reset so the crash record gets reported
+        [[noreturn]] static auto halt() -> void {
+            if (CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) {
+                for (;;) {
+                    __NOP();
+                }
+            }
+            NVIC_SystemReset();
+        }
+
         System() = default;
         ~System() = default;
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "sys.hpp"
+
+namespace mrover {
+
+    /**
+     * Disciplines the local 64-bit DWT timebase to the host clock.
+     *
+     * The host sends ESWTimeSync, notes when it left, then sends that time in ESWTimeSyncFollowUp.
+     * The board records the local receive time of the sync (back-dated with the FDCAN RX timestamp),
+     * and on the matching follow-up steps its offset and filters the rate error between the two clocks.
+     */
+    class TimeSync {
+        static constexpr uint64_t SYNC_TIMEOUT_US = 5'000'000;
+        static constexpr uint64_t MAX_DRIFT_INTERVAL_US = 10'000'000;
+        static constexpr float DRIFT_GAIN = 0.25f;
+        static constexpr float MAX_DRIFT = 500e-6f;
+
+        struct Reference {
+            uint64_t local_us{};
+            uint64_t host_us{};
+            float drift{}; // host rate relative to local rate, minus one
+            bool valid{};
+
+            [[nodiscard]] auto predict_host_us(uint64_t const local) const -> uint64_t {
+                auto const elapsed = static_cast<int64_t>(local - local_us);
+                return host_us + elapsed + static_cast<int64_t>(static_cast<float>(elapsed) * drift);
+            }
+        };
+
+        uint8_t m_pending_sequence{};
+        uint64_t m_pending_local_us{};
+        bool m_pending{};
+        Reference m_ref{};
+
+        // the sync pair is usually handled from the FDCAN interrupt, so readers take a consistent copy
+        [[nodiscard]] auto reference() const -> Reference {
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            Reference const ref = m_ref;
+            __set_PRIMASK(primask);
+            return ref;
+        }
+
+    public:
+        auto on_sync(uint8_t const sequence, uint64_t const local_rx_us) -> void {
+            m_pending_sequence = sequence;
+            m_pending_local_us = local_rx_us;
+            m_pending = true;
+        }
+
+        auto on_follow_up(uint8_t const sequence, uint64_t const host_us) -> void {
+            if (!m_pending || sequence != m_pending_sequence) return;
+            m_pending = false;
+
+            Reference ref = m_ref;
+            if (uint64_t const interval = m_pending_local_us - ref.local_us;
+                ref.valid && interval > 0 && interval < MAX_DRIFT_INTERVAL_US) {
+                auto const error = static_cast<int64_t>(host_us - ref.predict_host_us(m_pending_local_us));
+                ref.drift = std::clamp(ref.drift + DRIFT_GAIN * static_cast<float>(error) / static_cast<float>(interval), -MAX_DRIFT, MAX_DRIFT);
+            }
+            ref.local_us = m_pending_local_us;
+            ref.host_us = host_us;
+            ref.valid = true;
+
+            uint32_t const primask = __get_PRIMASK();
+            __disable_irq();
+            m_ref = ref;
+            __set_PRIMASK(primask);
+        }
+
+        [[nodiscard]] auto synced(uint64_t const local_us) const -> bool {
+            Reference const ref = reference();
+            return ref.valid && local_us - ref.local_us < SYNC_TIMEOUT_US;
+        }
+
+        [[nodiscard]] auto synced() const -> bool {
+            return synced(System::get_micros64());
+        }
+
+        [[nodiscard]] auto to_host_us(uint64_t const local_us) const -> uint64_t {
+            Reference const ref = reference();
+            return ref.valid ? ref.predict_host_us(local_us) : 0;
+        }
+
+        [[nodiscard]] auto now_us() const -> uint64_t {
+            return to_host_us(System::get_micros64());
+        }
+
+        [[nodiscard]] auto drift() const -> float {
+            return reference().drift;
+        }
+
+        /**
+         * Truncated host time of a local sample for the timestamp field of state messages.
+         * Zero means the board is not synchronized; the host unwraps the 32-bit value.
+         */
+        [[nodiscard]] auto message_timestamp(uint64_t const local_us) const -> uint32_t {
+            Reference const ref = reference();
+            if (!ref.valid || System::get_micros64() - ref.local_us >= SYNC_TIMEOUT_US) return 0;
+            auto const timestamp = static_cast<uint32_t>(ref.predict_host_us(local_us));
+            return timestamp ? timestamp : 1;
+        }
+
+        [[nodiscard]] auto message_timestamp() const -> uint32_t {
+            return message_timestamp(System::get_micros64());
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <utility>
+
+namespace mrover {
+
+    /**
+     * Relay feedback experiment (Astrom and Hagglund) to find the ultimate gain and period of a loop.
+     *
+     * Switching the output between two levels around the setpoint drives most plants into a steady oscillation
+     * at the frequency where they lag by half a turn. The describing function of the relay then gives the gain
+     * a proportional controller would oscillate at, without ever running the loop at the edge of stability.
+     * The relay switches with hysteresis so noise cannot chatter it, and its centre follows the mean output
+     * of each cycle, so a load such as gravity or a velocity away from zero does not skew the oscillation.
+     */
+    class RelayAutotune {
+    public:
+        static constexpr std::size_t MAX_CYCLES = 8;
+
+        enum class Status : uint8_t {
+            IDLE = 0,
+            RUNNING = 1,
+            DONE = 2,
+            TIMED_OUT = 3, // no steady oscillation in time
+            ABORTED = 4,   // stopped by the caller, e.g. for leaving the safe range
+        };
+
+        struct Options {
+            float amplitude{};         // output either side of the centre
+            float hysteresis{};        // error the relay switches at, in input units
+            uint8_t settle_cycles{2};  // ignored while the transient dies out
+            uint8_t cycles{4};         // averaged once settled, at most MAX_CYCLES
+            float tolerance{0.1f};     // largest spread of the averaged periods and amplitudes, relative to their mean
+            float timeout_s{30.0f};
+        };
+
+        struct Result {
+            float ultimate_gain{};
+            float ultimate_period{}; // seconds
+        };
+
+    private:
+        struct Cycle {
+            float period;
+            float amplitude;
+        };
+
+        Options m_options{};
+        Status m_status{Status::IDLE};
+        Result m_result{};
+
+        float m_setpoint{};
+        float m_centre{};
+        bool m_high{};
+        float m_elapsed{};
+        float m_dt{}; // of the last step, the resolution the periods are measured at
+
+        // the cycle in progress, from one upward switch to the next
+        bool m_in_cycle{};
+        float m_cycle_time{};
+        float m_cycle_output{}; // output integrated over the cycle
+        float m_peak{};
+        float m_trough{};
+        uint8_t m_completed{};
+
+        std::array<Cycle, MAX_CYCLES> m_cycles{};
+        std::size_t m_next{};
+
+        [[nodiscard]] auto output() const -> float {
+            return m_high ? m_centre + m_options.amplitude : m_centre - m_options.amplitude;
+        }
+
+        auto finish_cycle() -> void {
+            Cycle const cycle{m_cycle_time, (m_peak - m_trough) / 2.0f};
+            m_centre = m_cycle_output / m_cycle_time;
+            if (++m_completed <= m_options.settle_cycles) return;
+
+            m_cycles[m_next] = cycle;
+            m_next = (m_next + 1) % m_options.cycles;
+            if (m_completed < m_options.settle_cycles + m_options.cycles) return;
+
+            // only trust an oscillation that repeats
+            auto const spread = [&](auto const member) {
+                float low = m_cycles[0].*member, high = low, sum = 0.0f;
+                for (std::size_t i = 0; i < m_options.cycles; ++i) {
+                    low = std::min(low, m_cycles[i].*member);
+                    high = std::max(high, m_cycles[i].*member);
+                    sum += m_cycles[i].*member;
+                }
+                return std::pair{high - low, sum / static_cast<float>(m_options.cycles)};
+            };
+            // periods are whole steps, and a period of a few steps alternates between the ones either side
+            auto const [period_range, period] = spread(&Cycle::period);
+            auto const [amplitude_range, amplitude] = spread(&Cycle::amplitude);
+            if (!(period_range <= m_options.tolerance * period + 2.01f * m_dt && amplitude_range <= m_options.tolerance * amplitude)) return;
+
+            // the hysteresis moves the switching point off the peak, which the describing function corrects for
+            float const hysteresis = std::min(m_options.hysteresis, amplitude * 0.9f);
+            float const effective = std::sqrt(amplitude * amplitude - hysteresis * hysteresis);
+            m_result = {
+                    .ultimate_gain = 4.0f * m_options.amplitude / (std::numbers::pi_v<float> * effective),
+                    .ultimate_period = period,
+            };
+            m_status = Status::DONE;
+        }
+
+    public:
+        RelayAutotune() = default;
+
+        explicit RelayAutotune(Options const& options) : m_options{options} {
+            m_options.cycles = std::clamp<uint8_t>(m_options.cycles, 1, MAX_CYCLES);
+        }
+
+        /**
+         * Begin the experiment around a setpoint.
+         * @param centre output that roughly holds the setpoint, refined as the experiment runs
+         */
+        auto start(float const setpoint, float const centre = 0.0f) -> void {
+            m_status = Status::RUNNING;
+            m_setpoint = setpoint;
+            m_centre = centre;
+            m_high = false;
+            m_elapsed = 0.0f;
+            m_in_cycle = false;
+            m_completed = 0;
+            m_next = 0;
+        }
+
+        /**
+         * @param input measurement of the loop being tuned
+         * @param dt    seconds since the last call
+         * @return      output to apply, the centre once the experiment is over
+         */
+        auto step(float const input, float const dt) -> float {
+            if (m_status != Status::RUNNING) return m_centre;
+            m_elapsed += dt;
+            m_dt = dt;
+            if (m_elapsed > m_options.timeout_s) {
+                m_status = Status::TIMED_OUT;
+                return m_centre;
+            }
+
+            float const error = m_setpoint - input;
+            if (m_high && error < -m_options.hysteresis) {
+                m_high = false;
+            } else if (!m_high && error > m_options.hysteresis) {
+                m_high = true;
+                // a cycle ends and the next begins on every upward switch
+                if (m_in_cycle) finish_cycle();
+                if (m_status != Status::RUNNING) return m_centre;
+                m_in_cycle = true;
+                m_cycle_time = 0.0f;
+                m_cycle_output = 0.0f;
+                m_peak = m_trough = input;
+            }
+
+            float const out = output();
+            if (m_in_cycle) {
+                m_cycle_time += dt;
+                m_cycle_output += out * dt;
+                m_peak = std::max(m_peak, input);
+                m_trough = std::min(m_trough, input);
+            }
+            return out;
+        }
+
+        auto abort() -> void {
+            if (m_status == Status::RUNNING) m_status = Status::ABORTED;
+        }
+
+        [[nodiscard]] auto status() const -> Status {
+            return m_status;
+        }
+
+        /**
+         * @return the ultimate gain and period, valid once done
+         */
+        [[nodiscard]] auto result() const -> Result const& {
+            return m_result;
+        }
+    };
+
+    // rules turning the ultimate gain and period into gains, the PI ones for loops that do not want a derivative
+    enum class TuningRule : uint8_t {
+        ZIEGLER_NICHOLS = 0,    // quarter decay, fast but overshoots
+        TYREUS_LUYBEN = 1,      // less overshoot and more margin, slower to settle
+        NO_OVERSHOOT = 2,       // the Ziegler-Nichols variant for loops that must not overshoot
+        ZIEGLER_NICHOLS_PI = 3,
+        TYREUS_LUYBEN_PI = 4,
+    };
+
+    struct PIDGains {
+        float p{};
+        float i{};
+        float d{};
+    };
+
+    /**
+     * Gains for the parallel form PIDF uses, from the ultimate gain and period.
+     */
+    constexpr auto tune_gains(RelayAutotune::Result const& result, TuningRule const rule) -> PIDGains {
+        // proportional as a fraction of the ultimate gain, integral and derivative times as fractions of the period
+        struct Factors {
+            float p, ti, td;
+        };
+        Factors const factors = [rule] -> Factors {
+            switch (rule) {
+                case TuningRule::TYREUS_LUYBEN:
+                    return {1.0f / 2.2f, 2.2f, 1.0f / 6.3f};
+                case TuningRule::NO_OVERSHOOT:
+                    return {0.2f, 0.5f, 1.0f / 3.0f};
+                case TuningRule::ZIEGLER_NICHOLS_PI:
+                    return {0.45f, 1.0f / 1.2f, 0.0f};
+                case TuningRule::TYREUS_LUYBEN_PI:
+                    return {1.0f / 3.2f, 2.2f, 0.0f};
+                case TuningRule::ZIEGLER_NICHOLS:
+                default:
+                    return {0.6f, 0.5f, 0.125f};
+            }
+        }();
+        float const p = factors.p * result.ultimate_gain;
+        return {
+                .p = p,
+                .i = p / (factors.ti * result.ultimate_period),
+                .d = p * factors.td * result.ultimate_period,
+        };
+    }
+
+} // namespace mrover
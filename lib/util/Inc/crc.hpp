@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace mrover {
+
+    /**
+     * CRC-32 (IEEE 802.3, reflected), matching Python's zlib.crc32.
+     */
+    class Crc32 {
+        static constexpr uint32_t POLYNOMIAL = 0xEDB88320;
+
+        static constexpr auto TABLE = [] -> std::array<uint32_t, 256> {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t i = 0; i < table.size(); ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = crc & 1 ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+                }
+                table[i] = crc;
+            }
+            return table;
+        }();
+
+        uint32_t m_crc{0xFFFFFFFF};
+
+    public:
+        constexpr auto update(uint8_t const byte) -> void {
+            m_crc = (m_crc >> 8) ^ TABLE[(m_crc ^ byte) & 0xFF];
+        }
+
+        constexpr auto update(std::span<uint8_t const> const bytes) -> void {
+            for (uint8_t const byte: bytes) update(byte);
+        }
+
+        [[nodiscard]] constexpr auto value() const -> uint32_t {
+            return m_crc ^ 0xFFFFFFFF;
+        }
+
+        constexpr auto reset() -> void {
+            m_crc = 0xFFFFFFFF;
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+
+namespace mrover {
+
+    /**
+     * Complementary filter putting a relative encoder on the scale of a slower, delayed absolute one.
+     *
+     * The relative position passes straight through, only the offset between the two is filtered,
+     * so the output has the bandwidth of the relative encoder and the drift of neither.
+     * Absolute samples arrive late, so each is compared against the relative position recorded at the time
+     * it was sampled rather than the one now, and the delay never shows up as an error to correct.
+     */
+    class EncoderFusion {
+        static constexpr std::size_t HISTORY_SIZE = 128;
+        static constexpr uint32_t RECORD_INTERVAL_US = 1000; // covers 128 ms of delay
+
+        struct Sample {
+            uint32_t time_us;
+            float relative;
+        };
+
+        std::array<Sample, HISTORY_SIZE> m_history{};
+        std::size_t m_newest{};
+        std::size_t m_count{};
+
+        float m_crossover_hz{};
+        float m_offset{}; // absolute minus relative
+        uint32_t m_last_correction_us{};
+        bool m_locked{false};
+
+        // relative position at a past time, interpolated between the samples either side
+        [[nodiscard]] auto relative_at(uint32_t const time_us, float& relative) const -> bool {
+            if (m_count == 0) return false;
+            Sample const& newest = m_history[m_newest];
+            if (static_cast<int32_t>(time_us - newest.time_us) >= 0) {
+                relative = newest.relative;
+                return true;
+            }
+            Sample after = newest;
+            for (std::size_t i = 1; i < m_count; ++i) {
+                Sample const& before = m_history[(m_newest + HISTORY_SIZE - i) % HISTORY_SIZE];
+                if (static_cast<int32_t>(time_us - before.time_us) >= 0) {
+                    float const span = static_cast<float>(after.time_us - before.time_us);
+                    float const t = static_cast<float>(time_us - before.time_us) / span;
+                    relative = before.relative + t * (after.relative - before.relative);
+                    return true;
+                }
+                after = before;
+            }
+            return false; // older than anything recorded
+        }
+
+    public:
+        EncoderFusion() = default;
+
+        /**
+         * @param crossover_hz below this the absolute encoder is trusted, above it the relative one
+         */
+        explicit EncoderFusion(float const crossover_hz) : m_crossover_hz{crossover_hz} {}
+
+        /**
+         * Record the relative position, call on every sample of it.
+         */
+        auto record(uint32_t const time_us, float const relative) -> void {
+            // the newest slot follows the latest sample until it is an interval past the one before,
+            // so a slot is only spent per interval but always holds a value at the time it is stamped with
+            if (m_count > 1 && m_history[m_newest].time_us - m_history[(m_newest + HISTORY_SIZE - 1) % HISTORY_SIZE].time_us < RECORD_INTERVAL_US) {
+                m_history[m_newest] = {time_us, relative};
+                return;
+            }
+            m_newest = (m_newest + 1) % HISTORY_SIZE;
+            m_history[m_newest] = {time_us, relative};
+            if (m_count < HISTORY_SIZE) ++m_count;
+        }
+
+        /**
+         * Correct the offset with an absolute sample.
+         * @param sample_us when the absolute position was sampled, on the clock record is called with
+         * @return          false if the sample is older than the recorded history and was dropped
+         */
+        auto correct(uint32_t const sample_us, float const absolute) -> bool {
+            float relative;
+            if (!relative_at(sample_us, relative)) return false;
+
+            float const error = absolute - relative - m_offset;
+            if (!m_locked) {
+                m_offset += error;
+                m_locked = true;
+            } else {
+                // first-order low-pass at the crossover, stepped by the time since the last correction
+                float const dt = static_cast<float>(sample_us - m_last_correction_us) * 1e-6f;
+                float const gain = 1.0f - std::exp(-2.0f * std::numbers::pi_v<float> * m_crossover_hz * dt);
+                m_offset += std::fmin(std::fmax(gain, 0.0f), 1.0f) * error;
+            }
+            m_last_correction_us = sample_us;
+            return true;
+        }
+
+        /**
+         * @return absolute minus relative, valid once locked
+         */
+        [[nodiscard]] auto offset() const -> float {
+            return m_offset;
+        }
+
+        [[nodiscard]] auto locked() const -> bool {
+            return m_locked;
+        }
+
+        auto set_crossover(float const crossover_hz) -> void {
+            m_crossover_hz = crossover_hz;
+        }
+
+        auto reset() -> void {
+            m_count = 0;
+            m_offset = 0.0f;
+            m_locked = false;
+        }
+    };
+
+} // namespace mrover
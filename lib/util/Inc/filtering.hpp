@@ -4,6 +4,8 @@
 #include <array>
 #include <cstddef>
 #include <numeric>
+#include <span>
+#include <type_traits>
 #include <utility>
 
 namespace mrover {
@@ -19,14 +21,20 @@ namespace mrover {
         auto add_reading(T reading) -> void {
             m_running_sum += reading - std::exchange(m_circular_buffer[m_index], reading);
             m_index = (m_index + 1) % Size;
+            // floating point sums drift as rounding errors pile up, start over from the buffer once per lap
+            if constexpr (std::is_floating_point_v<T>) {
+                if (m_index == 0) m_running_sum = std::reduce(m_circular_buffer.begin(), m_circular_buffer.end());
+            }
         }
 
         auto clear() -> void {
             m_circular_buffer.fill(T{});
+            m_running_sum = T{};
+            m_index = 0;
         }
 
         [[nodiscard]] auto get_filtered() const -> T {
-            return std::reduce(m_circular_buffer.begin(), m_circular_buffer.end()) / Size;
+            return m_running_sum / static_cast<T>(Size);
         }
     };
 
@@ -49,8 +57,212 @@ namespace mrover {
         }
     };
 
-    template<typename T>
-    class ButterworthFilter {
+    namespace detail {
+
+        inline constexpr double PI = 3.14159265358979323846;
+
+        // Taylor series after reducing to [-pi, pi], the standard ones are not constexpr until C++26
+        constexpr auto sin(double x) -> double {
+            x -= 2.0 * PI * static_cast<double>(static_cast<long long>(x / (2.0 * PI) + (x < 0.0 ? -0.5 : 0.5)));
+            double term = x;
+            double sum = x;
+            for (int n = 1; n < 20; ++n) {
+                term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+                sum += term;
+            }
+            return sum;
+        }
+
+        constexpr auto cos(double const x) -> double {
+            return sin(x + PI / 2.0);
+        }
+
+        constexpr auto tan(double const x) -> double {
+            return sin(x) / cos(x);
+        }
+
+    } // namespace detail
+
+    /**
+     * One second-order section, normalized so a0 is 1:
+     * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+     */
+    struct BiquadCoefficients {
+        double b0{1.0};
+        double b1{};
+        double b2{};
+        double a1{};
+        double a2{};
+    };
+
+    enum class FilterPass {
+        LOW,
+        HIGH,
+    };
+
+    /**
+     * Butterworth design by the bilinear transform, prewarped so the -3 dB point lands exactly on the cutoff.
+     * Odd orders end in a first-order section.
+     *
+     * @tparam Order    filter order, the roll-off is 20 dB/decade per order
+     * @param cutoff_hz -3 dB frequency, below Nyquist
+     * @param sample_hz rate the filter is fed at
+     */
+    template<std::size_t Order>
+    constexpr auto butterworth(FilterPass const pass, double const cutoff_hz, double const sample_hz) -> std::array<BiquadCoefficients, (Order + 1) / 2> {
+        static_assert(Order > 0, "a filter needs at least one pole");
+        std::array<BiquadCoefficients, (Order + 1) / 2> sections{};
+
+        double const k = detail::tan(detail::PI * cutoff_hz / sample_hz);
+        for (std::size_t i = 0; i < Order / 2; ++i) {
+            // pole pair quality factor, poles evenly spaced on the unit circle of the analog prototype, odd orders have one on the real axis
+            double const q = 1.0 / (2.0 * detail::cos(detail::PI * static_cast<double>(2 * i + 1 + Order % 2) / static_cast<double>(2 * Order)));
+            double const norm = 1.0 / (1.0 + k / q + k * k);
+            BiquadCoefficients& s = sections[i];
+            if (pass == FilterPass::LOW) {
+                s.b0 = k * k * norm;
+                s.b1 = 2.0 * s.b0;
+            } else {
+                s.b0 = norm;
+                s.b1 = -2.0 * s.b0;
+            }
+            s.b2 = s.b0;
+            s.a1 = 2.0 * (k * k - 1.0) * norm;
+            s.a2 = (1.0 - k / q + k * k) * norm;
+        }
+        if constexpr (Order % 2 == 1) {
+            double const norm = 1.0 / (1.0 + k);
+            BiquadCoefficients& s = sections.back();
+            s.b0 = pass == FilterPass::LOW ? k * norm : norm;
+            s.b1 = pass == FilterPass::LOW ? s.b0 : -s.b0;
+            s.a1 = (k - 1.0) * norm;
+        }
+        return sections;
+    }
+
+    /**
+     * Second-order notch, unity gain away from the center frequency.
+     * @param q center frequency over the -3 dB bandwidth
+     */
+    constexpr auto notch(double const center_hz, double const q, double const sample_hz) -> std::array<BiquadCoefficients, 1> {
+        double const w0 = 2.0 * detail::PI * center_hz / sample_hz;
+        double const alpha = detail::sin(w0) / (2.0 * q);
+        double const norm = 1.0 / (1.0 + alpha);
+        return {{{
+                .b0 = norm,
+                .b1 = -2.0 * detail::cos(w0) * norm,
+                .b2 = norm,
+                .a1 = -2.0 * detail::cos(w0) * norm,
+                .a2 = (1.0 - alpha) * norm,
+        }}};
+    }
+
+    /**
+     * Cascade of second-order sections in transposed direct form II, which keeps float round-off low at low cutoffs.
+     */
+    template<typename T, std::size_t Sections>
+    class BiquadFilter {
+        struct Section {
+            T b0, b1, b2, a1, a2;
+        };
+
+        std::array<Section, Sections> m_sections{};
+        std::array<std::array<T, 2>, Sections> m_state{};
+        T m_value{};
+
+    public:
+        constexpr BiquadFilter() = default;
+
+        constexpr explicit BiquadFilter(std::array<BiquadCoefficients, Sections> const& coefficients) {
+            for (std::size_t i = 0; i < Sections; ++i) {
+                auto const& [b0, b1, b2, a1, a2] = coefficients[i];
+                m_sections[i] = {static_cast<T>(b0), static_cast<T>(b1), static_cast<T>(b2), static_cast<T>(a1), static_cast<T>(a2)};
+            }
+        }
+
+        auto process(T sample) -> T {
+            for (std::size_t i = 0; i < Sections; ++i) {
+                auto const& [b0, b1, b2, a1, a2] = m_sections[i];
+                auto& [z1, z2] = m_state[i];
+                T const out = b0 * sample + z1;
+                z1 = b1 * sample - a1 * out + z2;
+                z2 = b2 * sample - a2 * out;
+                sample = out;
+            }
+            m_value = sample;
+            return sample;
+        }
+
+        /**
+         * Filter a block in place, the same as calling process on every sample in order.
+         * Runs one section over the whole block at a time, so its coefficients and state stay in registers,
+         * and the feedforward half of each section has no dependency between samples for the compiler to vectorize.
+         */
+        auto process(std::span<T> const samples) -> void {
+            for (std::size_t i = 0; i < Sections; ++i) {
+                auto const [b0, b1, b2, a1, a2] = m_sections[i];
+                auto [z1, z2] = m_state[i];
+                for (T& sample: samples) {
+                    T const in = sample;
+                    T const out = b0 * in + z1;
+                    z1 = b1 * in - a1 * out + z2;
+                    z2 = b2 * in - a2 * out;
+                    sample = out;
+                }
+                m_state[i] = {z1, z2};
+            }
+            if (!samples.empty()) m_value = samples.back();
+        }
+
+        auto add_reading(T const reading) -> void {
+            process(reading);
+        }
+
+        [[nodiscard]] auto get_filtered() const -> T {
+            return m_value;
+        }
+
+        auto clear() -> void {
+            for (auto& state: m_state) state.fill(T{});
+            m_value = T{};
+        }
+
+        // start in steady state at a value, so the first readings do not ring up from zero
+        auto reset(T const value) -> void {
+            for (std::size_t i = 0; i < Sections; ++i) {
+                auto const& [b0, b1, b2, a1, a2] = m_sections[i];
+                T const gain = (b0 + b1 + b2) / (T{1} + a1 + a2);
+                T const in = i == 0 ? value : m_value;
+                T const out = gain * in;
+                m_state[i] = {b1 * in - a1 * out + (b2 * in - a2 * out), b2 * in - a2 * out};
+                m_value = out;
+            }
+        }
+    };
+
+    /**
+     * Butterworth low or high-pass with its coefficients designed at compile time.
+     *
+     * @tparam Order        filter order, the roll-off is 20 dB/decade per order
+     * @tparam CutoffHz     -3 dB frequency
+     * @tparam SampleHz     rate add_reading is called at
+     */
+    template<typename T, std::size_t Order, FilterPass Pass, double CutoffHz, double SampleHz>
+    class ButterworthFilter : public BiquadFilter<T, (Order + 1) / 2> {
+        static_assert(CutoffHz > 0.0 && CutoffHz < SampleHz / 2.0, "the cutoff must be between zero and Nyquist");
+        static constexpr auto COEFFICIENTS = butterworth<Order>(Pass, CutoffHz, SampleHz);
+
+    public:
+        constexpr ButterworthFilter() : BiquadFilter<T, (Order + 1) / 2>{COEFFICIENTS} {}
+    };
+
+    template<typename T, double CenterHz, double Q, double SampleHz>
+    class NotchFilter : public BiquadFilter<T, 1> {
+        static_assert(CenterHz > 0.0 && CenterHz < SampleHz / 2.0, "the center must be between zero and Nyquist");
+        static constexpr auto COEFFICIENTS = notch(CenterHz, Q, SampleHz);
+
+    public:
+        constexpr NotchFilter() : BiquadFilter<T, 1>{COEFFICIENTS} {}
     };
 
 } // namespace mrover
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <limits>
+
+namespace mrover {
+
+    /**
+     * Signed fixed-point fraction in [-1, 1), all FracBits below the sign bit.
+     *
+     * Arithmetic saturates instead of wrapping and products round to nearest,
+     * so a controller running on it degrades like an analog one when pushed past full scale.
+     *
+     * @tparam Storage  signed integer holding the raw value
+     * @tparam Wide     signed integer twice as wide, holds products
+     */
+    template<typename Storage, typename Wide, int FracBits>
+    class Fixed {
+        static_assert(std::numeric_limits<Storage>::digits == FracBits, "every bit below the sign is a fraction bit");
+        static_assert(sizeof(Wide) >= 2 * sizeof(Storage), "products need twice the width");
+
+        Storage m_raw{};
+
+        static constexpr auto saturate(Wide const value) -> Storage {
+            return static_cast<Storage>(std::clamp<Wide>(value, std::numeric_limits<Storage>::min(), std::numeric_limits<Storage>::max()));
+        }
+
+    public:
+        using storage_t = Storage;
+        using wide_t = Wide;
+        static constexpr int FRAC_BITS = FracBits;
+
+        constexpr Fixed() = default;
+
+        [[nodiscard]] static constexpr auto from_raw(Storage const raw) -> Fixed {
+            Fixed f;
+            f.m_raw = raw;
+            return f;
+        }
+
+        // saturates to [-1, 1 - 2^-FracBits], NaN maps to zero
+        [[nodiscard]] static constexpr auto from_float(float const value) -> Fixed {
+            if (std::isnan(value)) return {};
+            double const scaled = std::round(static_cast<double>(value) * static_cast<double>(Wide{1} << FracBits));
+            return from_raw(static_cast<Storage>(std::clamp<double>(scaled, std::numeric_limits<Storage>::min(), std::numeric_limits<Storage>::max())));
+        }
+
+        [[nodiscard]] static constexpr auto max() -> Fixed {
+            return from_raw(std::numeric_limits<Storage>::max());
+        }
+
+        [[nodiscard]] static constexpr auto min() -> Fixed {
+            return from_raw(std::numeric_limits<Storage>::min());
+        }
+
+        [[nodiscard]] constexpr auto raw() const -> Storage {
+            return m_raw;
+        }
+
+        [[nodiscard]] constexpr auto to_float() const -> float {
+            return static_cast<float>(m_raw) / static_cast<float>(Wide{1} << FracBits);
+        }
+
+        constexpr auto operator<=>(Fixed const&) const = default;
+
+        constexpr auto operator-() const -> Fixed {
+            return from_raw(saturate(-static_cast<Wide>(m_raw)));
+        }
+
+        friend constexpr auto operator+(Fixed const a, Fixed const b) -> Fixed {
+            return from_raw(saturate(static_cast<Wide>(a.m_raw) + b.m_raw));
+        }
+
+        friend constexpr auto operator-(Fixed const a, Fixed const b) -> Fixed {
+            return from_raw(saturate(static_cast<Wide>(a.m_raw) - b.m_raw));
+        }
+
+        friend constexpr auto operator*(Fixed const a, Fixed const b) -> Fixed {
+            Wide const product = static_cast<Wide>(a.m_raw) * b.m_raw;
+            return from_raw(saturate((product + (Wide{1} << (FracBits - 1))) >> FracBits));
+        }
+
+        constexpr auto operator+=(Fixed const other) -> Fixed& {
+            return *this = *this + other;
+        }
+
+        constexpr auto operator-=(Fixed const other) -> Fixed& {
+            return *this = *this - other;
+        }
+    };
+
+    using Q31 = Fixed<int32_t, int64_t, 31>;
+    using Q15 = Fixed<int16_t, int32_t, 15>;
+
+    /**
+     * Scale factor of any magnitude for fixed-point values: a Q31 mantissa and a power of two,
+     * since gains such as 300 throttle per unit error do not fit in a fraction.
+     */
+    class FixedGain {
+        int32_t m_mantissa{};
+        int m_exponent{};
+
+    public:
+        constexpr FixedGain() = default;
+
+        explicit FixedGain(float const gain) {
+            if (gain == 0.0f || std::isnan(gain)) return;
+            int exponent;
+            float const mantissa = std::frexp(gain, &exponent); // [0.5, 1) in magnitude
+            m_mantissa = Q31::from_float(mantissa).raw();
+            m_exponent = exponent;
+        }
+
+        [[nodiscard]] constexpr auto operator*(Q31 const value) const -> Q31 {
+            int const shift = 31 - m_exponent;
+            int64_t const product = static_cast<int64_t>(m_mantissa) * value.raw();
+            if (shift > 62) return Q31{};
+            if (shift <= 0) {
+                // a gain of 2^31 or more is full scale for any nonzero input
+                if (product == 0) return Q31{};
+                return product > 0 ? Q31::max() : Q31::min();
+            }
+            int64_t const rounded = (product + (int64_t{1} << (shift - 1))) >> shift;
+            return Q31::from_raw(static_cast<int32_t>(std::clamp<int64_t>(rounded, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max())));
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+
+#include "matrix.hpp"
+
+namespace mrover {
+
+    /**
+     * Linear Kalman filter with N states and M measured quantities, sized at compile time.
+     *
+     * The covariance update uses the Joseph form, which stays symmetric and positive definite
+     * in single precision where the short form drifts.
+     */
+    template<typename T, std::size_t N, std::size_t M>
+    class KalmanFilter {
+    public:
+        using state_t = Vector<T, N>;
+        using covariance_t = Matrix<T, N, N>;
+        using measurement_t = Vector<T, M>;
+
+    private:
+        state_t m_x{};
+        covariance_t m_p{};
+        Matrix<T, N, N> m_f{Matrix<T, N, N>::identity()}; // transition
+        Matrix<T, N, N> m_q{};                             // process noise
+        Matrix<T, M, N> m_h{};                             // measurement
+        Matrix<T, M, M> m_r{};                             // measurement noise
+
+    public:
+        constexpr KalmanFilter() = default;
+
+        constexpr KalmanFilter(Matrix<T, N, N> const& transition, Matrix<T, N, N> const& process_noise,
+                               Matrix<T, M, N> const& measurement, Matrix<T, M, M> const& measurement_noise)
+            : m_f{transition}, m_q{process_noise}, m_h{measurement}, m_r{measurement_noise} {}
+
+        auto reset(state_t const& state, covariance_t const& covariance) -> void {
+            m_x = state;
+            m_p = covariance;
+        }
+
+        auto predict() -> void {
+            m_x = m_f * m_x;
+            m_p = m_f * m_p * m_f.transpose() + m_q;
+        }
+
+        /**
+         * @return false if the innovation covariance is singular, the measurement is then ignored
+         */
+        auto update(measurement_t const& z) -> bool {
+            Matrix<T, N, M> const pht = m_p * m_h.transpose();
+            auto const s_inv = inverse_spd(m_h * pht + m_r);
+            if (!s_inv) return false;
+            Matrix<T, N, M> const k = pht * *s_inv;
+
+            m_x += k * (z - m_h * m_x);
+            Matrix<T, N, N> const i_kh = Matrix<T, N, N>::identity() - k * m_h;
+            m_p = i_kh * m_p * i_kh.transpose() + k * m_r * k.transpose();
+            return true;
+        }
+
+        [[nodiscard]] auto state() const -> state_t const& {
+            return m_x;
+        }
+
+        [[nodiscard]] auto covariance() const -> covariance_t const& {
+            return m_p;
+        }
+
+        auto set_transition(Matrix<T, N, N> const& transition) -> void {
+            m_f = transition;
+        }
+
+        auto set_process_noise(Matrix<T, N, N> const& process_noise) -> void {
+            m_q = process_noise;
+        }
+
+        auto set_measurement(Matrix<T, M, N> const& measurement) -> void {
+            m_h = measurement;
+        }
+
+        auto set_measurement_noise(Matrix<T, M, M> const& measurement_noise) -> void {
+            m_r = measurement_noise;
+        }
+    };
+
+    /**
+     * Position, velocity and acceleration of one axis from position measurements,
+     * with the acceleration driven by white jerk noise.
+     *
+     * The transition and process noise are rebuilt only when the time step changes, so a fixed-rate loop pays for them once.
+     */
+    template<typename T>
+    class KinematicEstimator {
+        KalmanFilter<T, 3, 1> m_filter;
+        T m_jerk_psd{}; // (unit/s^3)^2 per Hz
+        T m_dt{};       // zero forces a rebuild
+
+        auto discretize(T const dt) -> void {
+            T const dt2 = dt * dt;
+            T const dt3 = dt2 * dt;
+            m_filter.set_transition(Matrix<T, 3, 3>{
+                    T{1}, dt, dt2 / T{2},
+                    T{0}, T{1}, dt,
+                    T{0}, T{0}, T{1}});
+            // white jerk integrated over the step
+            T const q = m_jerk_psd;
+            m_filter.set_process_noise(Matrix<T, 3, 3>{
+                    q * dt3 * dt2 / T{20}, q * dt2 * dt2 / T{8}, q * dt3 / T{6},
+                    q * dt2 * dt2 / T{8}, q * dt3 / T{3}, q * dt2 / T{2},
+                    q * dt3 / T{6}, q * dt2 / T{2}, q * dt});
+            m_dt = dt;
+        }
+
+    public:
+        KinematicEstimator() = default;
+
+        /**
+         * @param jerk_psd          how hard the motion can change, higher follows faster and filters less
+         * @param position_variance measurement noise, (unit)^2
+         */
+        KinematicEstimator(T const jerk_psd, T const position_variance) : m_jerk_psd{jerk_psd} {
+            m_filter.set_measurement(Matrix<T, 1, 3>{T{1}, T{0}, T{0}});
+            m_filter.set_measurement_noise(Matrix<T, 1, 1>{position_variance});
+        }
+
+        /**
+         * Start at a position, at rest but unsure of it.
+         * @param velocity_variance how far from rest the motion might be, (unit/s)^2
+         */
+        auto reset(T const position, T const position_variance, T const velocity_variance, T const acceleration_variance) -> void {
+            m_filter.reset(Vector<T, 3>{position, T{0}, T{0}},
+                           Matrix<T, 3, 3>::diagonal({position_variance, velocity_variance, acceleration_variance}));
+        }
+
+        /**
+         * Advance to now, then correct with the position measured now.
+         * @param dt seconds since the last call
+         */
+        auto update(T const position, T const dt) -> void {
+            predict(dt);
+            m_filter.update(Vector<T, 1>{position});
+        }
+
+        // advance without a measurement, e.g. when one is missed
+        auto predict(T const dt) -> void {
+            if (dt != m_dt) discretize(dt);
+            m_filter.predict();
+        }
+
+        [[nodiscard]] auto position() const -> T {
+            return m_filter.state()[0];
+        }
+
+        [[nodiscard]] auto velocity() const -> T {
+            return m_filter.state()[1];
+        }
+
+        [[nodiscard]] auto acceleration() const -> T {
+            return m_filter.state()[2];
+        }
+
+        [[nodiscard]] auto filter() const -> KalmanFilter<T, 3, 1> const& {
+            return m_filter;
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace mrover {
+
+    namespace detail {
+
+        // calls f(std::integral_constant<std::size_t, I>{}) for I in [0, N), expanded at compile time
+        template<std::size_t N, typename F>
+        constexpr auto unroll(F&& f) -> void {
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (f(std::integral_constant<std::size_t, I>{}), ...);
+            }(std::make_index_sequence<N>{});
+        }
+
+    } // namespace detail
+
+    /**
+     * Fixed-size row-major matrix for the small systems the boards estimate, without Eigen or the heap.
+     *
+     * Every loop runs over compile-time bounds and is expanded in place, so a 3x3 product is
+     * straight-line multiply-adds with nothing to branch on.
+     */
+    template<typename T, std::size_t Rows, std::size_t Cols>
+    class Matrix {
+        static_assert(Rows > 0 && Cols > 0, "a matrix needs at least one element");
+
+        std::array<T, Rows * Cols> m_data{};
+
+    public:
+        static constexpr std::size_t ROWS = Rows;
+        static constexpr std::size_t COLS = Cols;
+
+        constexpr Matrix() = default;
+
+        // row by row
+        template<typename... Values>
+            requires(sizeof...(Values) == Rows * Cols && (std::is_convertible_v<Values, T> && ...))
+        constexpr explicit Matrix(Values const... values) : m_data{static_cast<T>(values)...} {}
+
+        [[nodiscard]] static constexpr auto zero() -> Matrix {
+            return {};
+        }
+
+        [[nodiscard]] static constexpr auto identity() -> Matrix {
+            static_assert(Rows == Cols, "identity is square");
+            Matrix m;
+            detail::unroll<Rows>([&](auto i) { m(i, i) = T{1}; });
+            return m;
+        }
+
+        [[nodiscard]] static constexpr auto diagonal(std::array<T, Rows> const& values) -> Matrix {
+            static_assert(Rows == Cols, "a diagonal matrix is square");
+            Matrix m;
+            detail::unroll<Rows>([&](auto i) { m(i, i) = values[i]; });
+            return m;
+        }
+
+        [[nodiscard]] constexpr auto operator()(std::size_t const row, std::size_t const col) -> T& {
+            return m_data[row * Cols + col];
+        }
+
+        [[nodiscard]] constexpr auto operator()(std::size_t const row, std::size_t const col) const -> T const& {
+            return m_data[row * Cols + col];
+        }
+
+        // element of a vector
+        [[nodiscard]] constexpr auto operator[](std::size_t const i) -> T& {
+            static_assert(Cols == 1, "single index access is for column vectors");
+            return m_data[i];
+        }
+
+        [[nodiscard]] constexpr auto operator[](std::size_t const i) const -> T const& {
+            static_assert(Cols == 1, "single index access is for column vectors");
+            return m_data[i];
+        }
+
+        [[nodiscard]] constexpr auto transpose() const -> Matrix<T, Cols, Rows> {
+            Matrix<T, Cols, Rows> m;
+            detail::unroll<Rows>([&](auto r) {
+                detail::unroll<Cols>([&](auto c) { m(c, r) = (*this)(r, c); });
+            });
+            return m;
+        }
+
+        constexpr auto operator+=(Matrix const& other) -> Matrix& {
+            detail::unroll<Rows * Cols>([&](auto i) { m_data[i] += other.m_data[i]; });
+            return *this;
+        }
+
+        constexpr auto operator-=(Matrix const& other) -> Matrix& {
+            detail::unroll<Rows * Cols>([&](auto i) { m_data[i] -= other.m_data[i]; });
+            return *this;
+        }
+
+        constexpr auto operator*=(T const scale) -> Matrix& {
+            detail::unroll<Rows * Cols>([&](auto i) { m_data[i] *= scale; });
+            return *this;
+        }
+
+        friend constexpr auto operator+(Matrix a, Matrix const& b) -> Matrix {
+            return a += b;
+        }
+
+        friend constexpr auto operator-(Matrix a, Matrix const& b) -> Matrix {
+            return a -= b;
+        }
+
+        friend constexpr auto operator*(Matrix a, T const scale) -> Matrix {
+            return a *= scale;
+        }
+
+        friend constexpr auto operator*(T const scale, Matrix a) -> Matrix {
+            return a *= scale;
+        }
+
+        constexpr auto operator==(Matrix const&) const -> bool = default;
+    };
+
+    template<typename T, std::size_t Rows, std::size_t Inner, std::size_t Cols>
+    constexpr auto operator*(Matrix<T, Rows, Inner> const& a, Matrix<T, Inner, Cols> const& b) -> Matrix<T, Rows, Cols> {
+        Matrix<T, Rows, Cols> m;
+        detail::unroll<Rows>([&](auto r) {
+            detail::unroll<Cols>([&](auto c) {
+                m(r, c) = [&]<std::size_t... K>(std::index_sequence<K...>) {
+                    return (T{} + ... + (a(r, K) * b(K, c)));
+                }(std::make_index_sequence<Inner>{});
+            });
+        });
+        return m;
+    }
+
+    template<typename T, std::size_t N>
+    using Vector = Matrix<T, N, 1>;
+
+    /**
+     * Inverse of a symmetric positive definite matrix, such as a covariance, through its Cholesky factor.
+     * @return nothing if the matrix is not positive definite
+     */
+    template<typename T, std::size_t N>
+    auto inverse_spd(Matrix<T, N, N> const& a) -> std::optional<Matrix<T, N, N>> {
+        if constexpr (N == 1) {
+            if (!(a(0, 0) > T{})) return std::nullopt;
+            return Matrix<T, 1, 1>{T{1} / a(0, 0)};
+        } else {
+            // a = L L^T
+            Matrix<T, N, N> l;
+            for (std::size_t j = 0; j < N; ++j) {
+                T d = a(j, j);
+                for (std::size_t k = 0; k < j; ++k) d -= l(j, k) * l(j, k);
+                if (!(d > T{})) return std::nullopt;
+                l(j, j) = std::sqrt(d);
+                for (std::size_t i = j + 1; i < N; ++i) {
+                    T s = a(i, j);
+                    for (std::size_t k = 0; k < j; ++k) s -= l(i, k) * l(j, k);
+                    l(i, j) = s / l(j, j);
+                }
+            }
+            // L^-1 by forward substitution, still lower triangular
+            Matrix<T, N, N> l_inv;
+            for (std::size_t j = 0; j < N; ++j) {
+                l_inv(j, j) = T{1} / l(j, j);
+                for (std::size_t i = j + 1; i < N; ++i) {
+                    T s{};
+                    for (std::size_t k = j; k < i; ++k) s -= l(i, k) * l_inv(k, j);
+                    l_inv(i, j) = s / l(i, i);
+                }
+            }
+            // a^-1 = L^-T L^-1
+            return l_inv.transpose() * l_inv;
+        }
+    }
+
+} // namespace mrover
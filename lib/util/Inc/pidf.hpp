@@ -2,29 +2,128 @@
 
 #include <algorithm>
 #include <cmath>
-#include <optional>
+#include <cstdint>
+
+#include "fixed.hpp"
 
 namespace mrover {
 
-    struct PIDF {
-    private:
-        // gains
+    /**
+     * Arithmetic for each scalar type a controller can run on.
+     * Fixed-point controllers keep their state and compute in Q31, Q15 is only the type of inputs and outputs.
+     */
+    template<typename T>
+    struct pidf_traits;
+
+    template<>
+    struct pidf_traits<float> {
+        using compute_t = float;
+        using gain_t = float;
+
+        static auto widen(float const value) -> float { return value; }
+        static auto narrow(float const value) -> float { return value; }
+        static auto from_float(float const value) -> float { return value; }
+        static auto make_gain(float const gain) -> float { return gain; }
+    };
+
+    template<>
+    struct pidf_traits<Q31> {
+        using compute_t = Q31;
+        using gain_t = FixedGain;
+
+        static auto widen(Q31 const value) -> Q31 { return value; }
+        static auto narrow(Q31 const value) -> Q31 { return value; }
+        static auto from_float(float const value) -> Q31 { return Q31::from_float(value); }
+        static auto make_gain(float const gain) -> FixedGain { return FixedGain{gain}; }
+    };
+
+    template<>
+    struct pidf_traits<Q15> {
+        using compute_t = Q31;
+        using gain_t = FixedGain;
+
+        static auto widen(Q15 const value) -> Q31 { return Q31::from_raw(static_cast<int32_t>(value.raw()) << 16); }
+        static auto narrow(Q31 const value) -> Q15 {
+            int32_t const rounded = (static_cast<int64_t>(value.raw()) + (1 << 15)) >> 16;
+            return Q15::from_raw(static_cast<int16_t>(std::min<int32_t>(rounded, INT16_MAX)));
+        }
+        static auto from_float(float const value) -> Q31 { return Q31::from_float(value); }
+        static auto make_gain(float const gain) -> FixedGain { return FixedGain{gain}; }
+    };
+
+    /**
+     * PIDF controller over a scalar type: float, or Q31/Q15 fractions for signals normalized to [-1, 1).
+     *
+     * The derivative acts on the measurement, so setpoint steps do not kick the output,
+     * and goes through a first-order low-pass with time constant with_d_filter (none by default).
+     * When the output saturates, back-calculation bleeds the integral by the excess, at the with_tracking rate.
+     * Gains are set as floats and multiplied out with the time step once; calls at a fixed dt never touch them again.
+     */
+    template<typename T>
+    class BasicPIDF {
+        using traits = pidf_traits<T>;
+        using compute_t = typename traits::compute_t;
+        using gain_t = typename traits::gain_t;
+
+        // gains, as configured
         float m_kp{0.0};
         float m_ki{0.0};
         float m_kd{0.0};
         float m_kff{0.0};
+        float m_kt{0.0};    // back-calculation rate in 1/s, zero drops the whole excess in one step
+        float m_d_tau{0.0}; // derivative filter time constant in seconds
 
         // settings
-        float m_dead_band{0.0};
-        float m_out_min{0.0};
-        float m_out_max{0.0};
-
-        // input bounds
-        std::optional<std::pair<float, float>> m_input_bound;
+        compute_t m_dead_band{};
+        compute_t m_out_min{};
+        compute_t m_out_max{};
+
+        // continuous input wrapping, half of the input range
+        compute_t m_wrap_half{};
+        bool m_wrap{false};
+
+        // gain products for the time step they were computed for, zero forces a recompute
+        float m_dt{0.0};
+        gain_t m_p{};
+        gain_t m_i{};   // ki * dt
+        gain_t m_d_a{}; // derivative filter pole
+        gain_t m_d_b{}; // kd through the derivative filter
+        gain_t m_aw{};  // back-calculation per step
+        gain_t m_ff{};
 
         // internal state
-        float m_total_error{0.0};
-        float m_last_error{0.0};
+        compute_t m_integral{}; // in output units
+        compute_t m_derivative{};
+        compute_t m_last_input{};
+        bool m_primed{false};
+
+        auto precompute(float const dt) -> void {
+            m_p = traits::make_gain(m_kp);
+            m_i = traits::make_gain(m_ki * dt);
+            m_d_a = traits::make_gain(m_d_tau / (m_d_tau + dt));
+            m_d_b = traits::make_gain(m_kd / (m_d_tau + dt));
+            m_aw = traits::make_gain(m_kt > 0.0f ? std::min(m_kt * dt, 1.0f) : 1.0f);
+            m_ff = traits::make_gain(m_kff);
+            m_dt = dt;
+        }
+
+        auto wrap(compute_t value) const -> compute_t {
+            if (!m_wrap) return value;
+            // subtract the range in halves, a full fixed-point range does not fit in the type
+            if (value > m_wrap_half) {
+                value -= m_wrap_half;
+                value -= m_wrap_half;
+            } else if (value < -m_wrap_half) {
+                value += m_wrap_half;
+                value += m_wrap_half;
+            }
+            return value;
+        }
+
+        auto invalidate() -> BasicPIDF& {
+            m_dt = 0.0f;
+            return *this;
+        }
 
     public:
         /**
@@ -35,81 +134,98 @@ namespace mrover {
          * @param dt        Time delta since last call (seconds)
          * @return          Clamped output value
          */
-        auto calculate(float const input, float const target, float const dt) -> float {
-            if (dt <= 0.0) return m_out_min;
-
-            float error = target - input;
-
-            // continuous input wrapping
-            if (m_input_bound) {
-                auto [in_min, in_max] = m_input_bound.value();
-                if (float const range = in_max - in_min; std::abs(error) > range / 2.0) {
-                    if (error > 0) {
-                        error -= range;
-                    } else {
-                        error += range;
-                    }
-                }
-            }
+        auto calculate(T const input, T const target, float const dt) -> T {
+            if (dt <= 0.0f) return traits::narrow(m_out_min);
+            if (dt != m_dt) precompute(dt);
 
-            // anti-windup
-            if (float const p_term = m_kp * error; p_term > m_out_min && p_term < m_out_max) {
-                m_total_error += error * dt;
-            } else {
-                m_total_error = 0.0;
-            }
+            compute_t const measured = traits::widen(input);
+            compute_t const setpoint = traits::widen(target);
+            compute_t const error = wrap(setpoint - measured);
 
             // deadband
-            float const error_for_p = (std::abs(error) < m_dead_band) ? 0.0 : error;
+            compute_t const error_for_p = error < m_dead_band && error > -m_dead_band ? compute_t{} : error;
+
+            // filtered derivative of the measurement, nothing to difference on the first call
+            if (m_primed) m_derivative = m_d_a * m_derivative - m_d_b * wrap(measured - m_last_input);
+            m_last_input = measured;
+            m_primed = true;
 
-            // term calcs
-            float const d_term = m_kd * (error - m_last_error) / dt;
-            float const i_term = m_ki * m_total_error;
-            float const ff_term = m_kff * target;
+            m_integral += m_i * error;
 
-            // calc result
-            float const result = (m_kp * error_for_p) + i_term + d_term + ff_term;
+            compute_t const result = m_p * error_for_p + m_integral + m_derivative + m_ff * setpoint;
+            compute_t const output = std::clamp(result, m_out_min, m_out_max);
 
-            m_last_error = error;
+            // anti-windup, pull the integral back by what the clamp cut off
+            m_integral += m_aw * (output - result);
 
-            return std::clamp(result, m_out_min, m_out_max);
+            return traits::narrow(output);
+        }
+
+        /**
+         * Forget the integral and the derivative history, e.g. before taking over from another controller.
+         */
+        auto reset() -> void {
+            m_integral = compute_t{};
+            m_derivative = compute_t{};
+            m_primed = false;
         }
 
-        auto with_p(float const p) -> PIDF& {
+        auto with_p(float const p) -> BasicPIDF& {
             m_kp = p;
-            return *this;
+            return invalidate();
         }
 
-        auto with_i(float const i) -> PIDF& {
+        auto with_i(float const i) -> BasicPIDF& {
             m_ki = i;
-            return *this;
+            return invalidate();
         }
 
-        auto with_d(float const d) -> PIDF& {
+        auto with_d(float const d) -> BasicPIDF& {
             m_kd = d;
-            return *this;
+            return invalidate();
         }
 
-        auto with_ff(float const ff) -> PIDF& {
+        auto with_ff(float const ff) -> BasicPIDF& {
             m_kff = ff;
-            return *this;
+            return invalidate();
         }
 
-        auto with_dead_band(float const dead_band) -> PIDF& {
-            m_dead_band = dead_band;
+        /**
+         * @param tau derivative low-pass time constant in seconds, zero for the raw difference
+         */
+        auto with_d_filter(float const tau) -> BasicPIDF& {
+            m_d_tau = std::max(tau, 0.0f);
+            return invalidate();
+        }
+
+        /**
+         * @param kt back-calculation rate in 1/s, zero to drop the whole excess on each step
+         */
+        auto with_tracking(float const kt) -> BasicPIDF& {
+            m_kt = std::max(kt, 0.0f);
+            return invalidate();
+        }
+
+        auto with_dead_band(float const dead_band) -> BasicPIDF& {
+            m_dead_band = traits::from_float(dead_band);
             return *this;
         }
 
-        auto with_input_bound(float min, float max) -> PIDF& {
-            m_input_bound = {min, max};
+        auto with_input_bound(float const min, float const max) -> BasicPIDF& {
+            m_wrap_half = traits::from_float((max - min) / 2.0f);
+            m_wrap = true;
             return *this;
         }
 
-        auto with_output_bound(float const min, float const max) -> PIDF& {
-            m_out_min = min;
-            m_out_max = max;
+        auto with_output_bound(float const min, float const max) -> BasicPIDF& {
+            m_out_min = traits::from_float(min);
+            m_out_max = traits::from_float(max);
             return *this;
         }
     };
 
+    using PIDF = BasicPIDF<float>;
+    using PIDFQ31 = BasicPIDF<Q31>;
+    using PIDFQ15 = BasicPIDF<Q15>;
+
 } // namespace mrover
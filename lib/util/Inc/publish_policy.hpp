@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace mrover {
+
+    /**
+     * Decides when a sampled state is worth putting on the bus.
+     *
+     * A state is sent when any value moved further than its deadband, when the event word changed
+     * (mode, fault, limit transitions...), or when the heartbeat period ran out without a send.
+     * Nothing is sent closer together than the minimum interval, events included.
+     * Erased flash reads as 0xFFFF periods and NaN deadbands, which mean off rather than a 65 s heartbeat or a signal that never counts.
+     */
+    template<std::size_t N>
+    class PublishPolicy {
+    public:
+        struct Options {
+            std::array<float, N> deadbands{}; // zero sends on any change
+            uint32_t heartbeat_ms{};          // zero disables the policy, the caller publishes at its own fixed rate
+            uint32_t min_interval_ms{};       // zero leaves the rate uncapped
+        };
+
+        // what a 16 bit config register reads as when never written
+        static constexpr uint32_t UNSET_MS = 0xFFFF;
+
+        PublishPolicy() = default;
+
+        explicit PublishPolicy(Options const& options) : m_options{options} {
+            if (m_options.heartbeat_ms == UNSET_MS) m_options.heartbeat_ms = 0;
+            if (m_options.min_interval_ms == UNSET_MS) m_options.min_interval_ms = 0;
+            // an unset deadband sends on any change like zero, and with NaN no change would ever count
+            for (float& deadband: m_options.deadbands) {
+                if (!std::isfinite(deadband) || deadband < 0.0f) deadband = 0.0f;
+            }
+        }
+
+        [[nodiscard]] auto options() const -> Options const& {
+            return m_options;
+        }
+
+        [[nodiscard]] auto enabled() const -> bool {
+            return m_options.heartbeat_ms != 0;
+        }
+
+        [[nodiscard]] auto should_publish(uint32_t const now_ms, std::array<float, N> const& values, uint32_t const events) const -> bool {
+            if (!m_published) return true;
+
+            uint32_t const elapsed_ms = now_ms - m_last_ms;
+            if (elapsed_ms < m_options.min_interval_ms) return false;
+            if (events != m_last_events) return true;
+            if (elapsed_ms >= m_options.heartbeat_ms) return true;
+
+            for (std::size_t i = 0; i < N; ++i) {
+                if (changed(values[i], m_last_values[i], m_options.deadbands[i])) return true;
+            }
+            return false;
+        }
+
+        auto mark_published(uint32_t const now_ms, std::array<float, N> const& values, uint32_t const events) -> void {
+            m_last_ms = now_ms;
+            m_last_values = values;
+            m_last_events = events;
+            m_published = true;
+        }
+
+        auto reset() -> void {
+            m_published = false;
+        }
+
+    private:
+        Options m_options{};
+        std::array<float, N> m_last_values{};
+        uint32_t m_last_events{};
+        uint32_t m_last_ms{};
+        bool m_published{};
+
+        // NaN marks a missing reading, so going to or from NaN is a change
+        static auto changed(float const value, float const last, float const deadband) -> bool {
+            if (std::isnan(value) || std::isnan(last)) return std::isnan(value) != std::isnan(last);
+            return std::fabs(value - last) > deadband;
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace mrover {
+
+    /**
+     * Hands a value from one writer to readers without masking interrupts.
+     *
+     * The writer bumps the sequence to odd, copies the value in and bumps it back to even.
+     * A reader retries whenever it saw an odd sequence or the sequence moved under its copy,
+     * so it never returns a torn value. The writer never waits.
+     *
+     * Meant for one core: the writer must be able to preempt the readers (e.g. a control interrupt
+     * publishing to the main loop), never the other way around, or a reader spins forever.
+     */
+    template<typename T>
+    class SeqLock {
+        static_assert(std::is_trivially_copyable_v<T>, "SeqLock values are copied word by word");
+
+        std::atomic<uint32_t> m_sequence{};
+        T m_value{};
+
+    public:
+        SeqLock() = default;
+
+        // copies take a consistent snapshot, so an owner can still be copied before the interrupts start
+        SeqLock(SeqLock const& other) : m_value{other.read()} {}
+
+        auto operator=(SeqLock const& other) -> SeqLock& {
+            write(other.read());
+            return *this;
+        }
+
+        auto write(T const& value) -> void {
+            uint32_t const sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            // readers run on the same core, so keeping the compiler from reordering is enough
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            m_value = value;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            m_sequence.store(sequence + 2, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] auto read() const -> T {
+            for (;;) {
+                uint32_t const before = m_sequence.load(std::memory_order_relaxed);
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                T const value = m_value;
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                if (before % 2 == 0 && m_sequence.load(std::memory_order_relaxed) == before) return value;
+            }
+        }
+    };
+
+} // namespace mrover
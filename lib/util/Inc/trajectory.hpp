@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace mrover {
+
+    /**
+     * Point-to-point motion profile, stepped by the control loop to turn one position target into a smooth move.
+     *
+     * With a jerk limit the profile is a double S curve: jerk, constant acceleration and jerk back to cruise,
+     * then the mirror image down to rest at the goal (Biagiotti & Melchiorri, Trajectory Planning for Automatic Machines, 3.4).
+     * Without one it degenerates to the trapezoid, acceleration steps straight to its limit.
+     * Short moves never reach the velocity or acceleration limit and get the time-optimal reduced profile instead.
+     *
+     * A new goal is planned from the current reference position and velocity, so position and velocity stay continuous.
+     * The acceleration is assumed to start from zero, a retarget mid-ramp steps it once.
+     * If the goal is behind the motion or too close to stop in time, the profile stops first and then heads back.
+     */
+    class Trajectory {
+    public:
+        struct Limits {
+            float max_velocity{};     // units/s
+            float max_acceleration{}; // units/s^2
+            float max_jerk{};         // units/s^3, zero for a trapezoidal profile
+        };
+
+        struct Setpoint {
+            float position{};
+            float velocity{};
+            float acceleration{};
+        };
+
+        Trajectory() = default;
+
+        explicit Trajectory(Limits const& limits) : m_limits{limits} {}
+
+        // both limits must be positive, NaN (erased flash) included
+        [[nodiscard]] auto valid() const -> bool {
+            return m_limits.max_velocity > 0.0f && m_limits.max_acceleration > 0.0f && !(m_limits.max_jerk < 0.0f);
+        }
+
+        /**
+         * Hold still at a position, e.g. the measured one when entering position control.
+         */
+        auto reset(float const position) -> void {
+            m_goal = position;
+            m_pending.reset();
+            plan_stop({position, 0.0f, 0.0f});
+        }
+
+        /**
+         * Head for a new goal from wherever the reference currently is.
+         * @param position  starting point, the current reference or a measurement
+         * @param velocity  velocity at the starting point
+         */
+        auto plan(float const position, float const velocity, float const goal) -> void {
+            m_goal = goal;
+            m_pending.reset();
+
+            float const direction = goal >= position ? 1.0f : -1.0f;
+            // an overshooting move has to come to rest before it can head for the goal
+            if (velocity * direction < 0.0f || stopping_distance(std::fabs(velocity)) > std::fabs(goal - position)) {
+                plan_stop({position, velocity, 0.0f});
+                m_pending = goal;
+                return;
+            }
+            plan_move(position, velocity, goal);
+        }
+
+        /**
+         * Retarget only when the goal moved, so a target repeated over the bus does not restart the profile.
+         */
+        auto set_goal(float const goal) -> void {
+            if (goal == m_goal) return;
+            Setpoint const now = sample(m_time);
+            plan(now.position, now.velocity, goal);
+        }
+
+        /**
+         * Advance the profile.
+         * @param dt    seconds since the last step
+         * @return      reference for this step
+         */
+        auto step(float const dt) -> Setpoint {
+            m_time = std::min(m_time + dt, duration());
+            if (m_pending && m_time >= duration()) {
+                float const goal = *m_pending;
+                plan(sample(m_time).position, 0.0f, goal);
+            }
+            return sample(m_time);
+        }
+
+        [[nodiscard]] auto done() const -> bool {
+            return !m_pending && m_time >= duration();
+        }
+
+        [[nodiscard]] auto goal() const -> float {
+            return m_goal;
+        }
+
+        auto set_limits(Limits const& limits) -> void {
+            m_limits = limits;
+        }
+
+    private:
+        Limits m_limits{};
+
+        // the plan, in the frame where it moves forward from the origin
+        float m_start{};
+        float m_sign{1.0f};
+        float m_v0{};    // starting velocity
+        float m_vlim{};  // cruise velocity
+        float m_alima{}; // acceleration plateau
+        float m_alimd{}; // deceleration plateau, negative
+        float m_jerk{};  // zero for a trapezoid
+        float m_tj1{};   // jerk phases while accelerating
+        float m_tj2{};   // jerk phases while decelerating
+        float m_ta{};    // acceleration, cruise and deceleration durations
+        float m_tv{};
+        float m_td{};
+
+        float m_time{};
+        float m_goal{};
+        std::optional<float> m_pending; // goal to head for once stopped
+
+        static constexpr int BISECTIONS = 24; // float precision on the reduced acceleration
+
+        [[nodiscard]] auto duration() const -> float {
+            return m_ta + m_tv + m_td;
+        }
+
+        [[nodiscard]] auto jerk_limited() const -> bool {
+            return m_limits.max_jerk > 0.0f;
+        }
+
+        [[nodiscard]] auto stopping_distance(float const speed) const -> float {
+            float const amax = m_limits.max_acceleration;
+            if (!jerk_limited()) return speed * speed / (2.0f * amax);
+            float const jmax = m_limits.max_jerk;
+            if (speed * jmax >= amax * amax) return 0.5f * speed * (amax / jmax + speed / amax);
+            return speed * std::sqrt(speed / jmax);
+        }
+
+        // deceleration only, down to rest from the given state
+        auto plan_stop(Setpoint const& from) -> void {
+            float const amax = m_limits.max_acceleration;
+            float const jmax = m_limits.max_jerk;
+            float const speed = std::fabs(from.velocity);
+
+            m_start = from.position;
+            m_sign = from.velocity >= 0.0f ? 1.0f : -1.0f;
+            m_v0 = speed;
+            m_vlim = speed;
+            m_jerk = jerk_limited() ? jmax : 0.0f;
+            m_tj1 = 0.0f;
+            m_ta = 0.0f;
+            m_tv = 0.0f;
+            m_alima = 0.0f;
+            if (speed <= 0.0f) {
+                m_tj2 = 0.0f;
+                m_td = 0.0f;
+                m_alimd = 0.0f;
+            } else if (!jerk_limited()) {
+                m_tj2 = 0.0f;
+                m_td = speed / amax;
+                m_alimd = -amax;
+            } else {
+                m_tj2 = speed * jmax >= amax * amax ? amax / jmax : std::sqrt(speed / jmax);
+                m_td = speed * jmax >= amax * amax ? m_tj2 + speed / amax : 2.0f * m_tj2;
+                m_alimd = -jmax * m_tj2;
+            }
+            m_time = 0.0f;
+        }
+
+        // forward move from a velocity low enough to stop at the goal
+        auto plan_move(float const position, float const velocity, float const goal) -> void {
+            m_start = position;
+            m_sign = goal >= position ? 1.0f : -1.0f;
+            m_time = 0.0f;
+
+            float const h = std::fabs(goal - position);
+            float const vmax = m_limits.max_velocity;
+            // a lowered limit takes effect right away rather than after the move
+            float const v0 = std::min(velocity * m_sign, vmax);
+            if (h <= 0.0f) {
+                plan_stop({position, 0.0f, 0.0f});
+                return;
+            }
+            m_v0 = v0;
+
+            if (!jerk_limited()) {
+                plan_trapezoid(h, v0);
+            } else {
+                plan_double_s(h, v0);
+            }
+        }
+
+        auto plan_trapezoid(float const h, float const v0) -> void {
+            float const vmax = m_limits.max_velocity;
+            float const amax = m_limits.max_acceleration;
+            m_jerk = 0.0f;
+            m_tj1 = 0.0f;
+            m_tj2 = 0.0f;
+            m_alima = amax;
+            m_alimd = -amax;
+
+            m_vlim = vmax;
+            m_ta = (vmax - v0) / amax;
+            m_td = vmax / amax;
+            m_tv = h / vmax - 0.5f * m_ta * (1.0f + v0 / vmax) - 0.5f * m_td;
+            if (m_tv < 0.0f) {
+                // triangle, peak where the acceleration and deceleration ramps meet
+                m_vlim = std::max(std::sqrt(h * amax + 0.5f * v0 * v0), v0);
+                m_ta = (m_vlim - v0) / amax;
+                m_td = m_vlim / amax;
+                m_tv = 0.0f;
+            }
+        }
+
+        auto plan_double_s(float const h, float const v0) -> void {
+            float const vmax = m_limits.max_velocity;
+            float const jmax = m_limits.max_jerk;
+            float const amax = m_limits.max_acceleration;
+            m_jerk = jmax;
+
+            // cruise at the velocity limit, if the move is long enough to reach it
+            if ((vmax - v0) * jmax < amax * amax) {
+                m_tj1 = std::sqrt((vmax - v0) / jmax);
+                m_ta = 2.0f * m_tj1;
+            } else {
+                m_tj1 = amax / jmax;
+                m_ta = m_tj1 + (vmax - v0) / amax;
+            }
+            if (vmax * jmax < amax * amax) {
+                m_tj2 = std::sqrt(vmax / jmax);
+                m_td = 2.0f * m_tj2;
+            } else {
+                m_tj2 = amax / jmax;
+                m_td = m_tj2 + vmax / amax;
+            }
+            m_tv = h / vmax - 0.5f * m_ta * (1.0f + v0 / vmax) - 0.5f * m_td;
+
+            if (m_tv <= 0.0f) {
+                // no cruise, the peak velocity stays below the limit
+                m_tv = 0.0f;
+                auto const shape = [&](float const a) -> bool {
+                    float const delta = a * a * a * a / (jmax * jmax) + 2.0f * v0 * v0 + a * (4.0f * h - 2.0f * a / jmax * v0);
+                    float const root = std::sqrt(std::max(delta, 0.0f));
+                    m_tj1 = a / jmax;
+                    m_tj2 = a / jmax;
+                    m_ta = (a * a / jmax - 2.0f * v0 + root) / (2.0f * a);
+                    m_td = (a * a / jmax + root) / (2.0f * a);
+                    // a negative acceleration phase means decelerating only, which does not need the plateau
+                    return m_ta < 0.0f || (m_ta >= 2.0f * m_tj1 && m_td >= 2.0f * m_tj2);
+                };
+                if (!shape(amax)) {
+                    // too short to reach the acceleration limit, search for the highest acceleration it does reach
+                    float lo = 0.0f;
+                    float hi = amax;
+                    for (int i = 0; i < BISECTIONS; ++i) {
+                        float const mid = (lo + hi) / 2.0f;
+                        (shape(mid) ? lo : hi) = mid;
+                    }
+                    shape(lo > 0.0f ? lo : hi);
+                }
+                if (m_ta < 0.0f) {
+                    m_ta = 0.0f;
+                    m_tj1 = 0.0f;
+                    m_td = 2.0f * h / v0;
+                    m_tj2 = (jmax * h - std::sqrt(std::max(jmax * (jmax * h * h - v0 * v0 * v0), 0.0f))) / (jmax * v0);
+                }
+            }
+
+            m_alima = jmax * m_tj1;
+            m_alimd = -jmax * m_tj2;
+            m_vlim = m_ta > 0.0f ? v0 + (m_ta - m_tj1) * m_alima : v0;
+        }
+
+        // reference at a time into the plan
+        [[nodiscard]] auto sample(float const t) const -> Setpoint {
+            float const j = m_jerk;
+            float const v0 = m_v0;
+            float const vlim = m_vlim;
+            float const total = duration();
+            // the goal end of the plan, in its own frame
+            float const end = (vlim + v0) * m_ta / 2.0f + vlim * m_tv + vlim * m_td / 2.0f;
+
+            float q, v, a;
+            if (t < m_tj1) {
+                q = v0 * t + j * t * t * t / 6.0f;
+                v = v0 + j * t * t / 2.0f;
+                a = j * t;
+            } else if (t < m_ta - m_tj1) {
+                q = v0 * t + m_alima / 6.0f * (3.0f * t * t - 3.0f * m_tj1 * t + m_tj1 * m_tj1);
+                v = v0 + m_alima * (t - m_tj1 / 2.0f);
+                a = m_alima;
+            } else if (t < m_ta) {
+                float const r = m_ta - t;
+                q = (vlim + v0) * m_ta / 2.0f - vlim * r + j * r * r * r / 6.0f;
+                v = vlim - j * r * r / 2.0f;
+                a = j * r;
+            } else if (t < m_ta + m_tv) {
+                q = (vlim + v0) * m_ta / 2.0f + vlim * (t - m_ta);
+                v = vlim;
+                a = 0.0f;
+            } else if (t < total - m_td + m_tj2) {
+                float const s = t - total + m_td;
+                q = end - vlim * m_td / 2.0f + vlim * s - j * s * s * s / 6.0f;
+                v = vlim - j * s * s / 2.0f;
+                a = -j * s;
+            } else if (t < total - m_tj2) {
+                float const s = t - total + m_td;
+                q = end - vlim * m_td / 2.0f + vlim * s + m_alimd / 6.0f * (3.0f * s * s - 3.0f * m_tj2 * s + m_tj2 * m_tj2);
+                v = vlim + m_alimd * (s - m_tj2 / 2.0f);
+                a = m_alimd;
+            } else if (t < total) {
+                float const r = total - t;
+                q = end - j * r * r * r / 6.0f;
+                v = j * r * r / 2.0f;
+                a = -j * r;
+            } else {
+                q = end;
+                v = 0.0f;
+                a = 0.0f;
+            }
+            return {m_start + m_sign * q, m_sign * v, m_sign * a};
+        }
+    };
+
+} // namespace mrover
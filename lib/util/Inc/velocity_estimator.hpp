@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+namespace mrover {
+
+    /**
+     * Encoder count at an edge, and when it happened in ticks of a free running timer.
+     */
+    struct EncoderEdge {
+        int32_t count;
+        uint32_t ticks;
+    };
+
+    /**
+     * Velocity from the time between encoder edges (M/T method): counts moved between the last edge seen
+     * on the previous update and the last edge seen on this one, over the time between those two edges.
+     *
+     * At low speed this is one edge period, so the estimate is exact to the timestamp resolution instead of
+     * being quantized to one count per update. At high speed many counts fall in between and it becomes
+     * count differencing over an interval ending on an edge, never a running average.
+     * When no edge arrives, the estimate decays as fast as the time since the last edge proves it must have.
+     */
+    class EdgeTimingEstimator {
+        float m_tick_s{};    // seconds per timestamp tick
+        float m_timeout_s{}; // no edge for this long is standing still
+        EncoderEdge m_last{};
+        bool m_has_last{false};
+        float m_velocity{}; // counts/s
+
+    public:
+        EdgeTimingEstimator() = default;
+
+        EdgeTimingEstimator(float const tick_s, float const timeout_s) : m_tick_s{tick_s}, m_timeout_s{timeout_s} {}
+
+        /**
+         * @param latest    most recent edge, or the current count and time when edges are not captured
+         * @param now_ticks current time on the same timer
+         * @return          counts/s
+         */
+        auto update(EncoderEdge const& latest, uint32_t const now_ticks) -> float {
+            if (!m_has_last) {
+                m_last = latest;
+                m_has_last = true;
+                return m_velocity = 0.0f;
+            }
+            if (latest.count != m_last.count && latest.ticks != m_last.ticks) {
+                float const interval_s = static_cast<float>(latest.ticks - m_last.ticks) * m_tick_s;
+                m_velocity = static_cast<float>(latest.count - m_last.count) / interval_s;
+                m_last = latest;
+                return m_velocity;
+            }
+
+            // no new edge, a speed that would have produced one by now is too high
+            float const since_edge_s = static_cast<float>(now_ticks - m_last.ticks) * m_tick_s;
+            if (since_edge_s > m_timeout_s) {
+                m_velocity = 0.0f;
+            } else if (std::fabs(m_velocity) * since_edge_s > 1.0f) {
+                m_velocity = std::copysign(1.0f / since_edge_s, m_velocity);
+            }
+            return m_velocity;
+        }
+
+        auto reset() -> void {
+            m_has_last = false;
+            m_velocity = 0.0f;
+        }
+    };
+
+    /**
+     * Velocity from a second-order tracking loop (PLL) locked on the encoder count.
+     *
+     * A PI loop drives an estimated position onto the measured count, its integrator is the velocity.
+     * Type 2, so a constant velocity is tracked with no position error, and the bandwidth trades
+     * count quantization noise against lag, critically damped.
+     */
+    class TrackingLoopEstimator {
+        float m_kp{}; // 1/s
+        float m_ki{}; // 1/s^2
+
+        // estimated position as a whole count plus a fraction, a float alone loses counts far from zero
+        int32_t m_base{};
+        float m_fraction{};
+        float m_velocity{}; // counts/s
+        bool m_locked{false};
+
+    public:
+        TrackingLoopEstimator() = default;
+
+        explicit TrackingLoopEstimator(float const bandwidth_hz) {
+            float const omega = 2.0f * std::numbers::pi_v<float> * bandwidth_hz;
+            m_kp = 2.0f * omega;
+            m_ki = omega * omega;
+        }
+
+        /**
+         * @param count encoder count now
+         * @param dt    seconds since the last update
+         * @return      counts/s
+         */
+        auto update(int32_t const count, float const dt) -> float {
+            if (!m_locked) {
+                m_base = count;
+                m_fraction = 0.5f;
+                m_locked = true;
+                return m_velocity;
+            }
+            if (dt <= 0.0f) return m_velocity;
+
+            // the count only says the shaft is somewhere in [count, count + 1), aim for the middle
+            float const error = static_cast<float>(count - m_base) + 0.5f - m_fraction;
+            m_velocity += m_ki * error * dt;
+            m_fraction += (m_velocity + m_kp * error) * dt;
+
+            float const whole = std::floor(m_fraction);
+            m_base += static_cast<int32_t>(whole);
+            m_fraction -= whole;
+            return m_velocity;
+        }
+
+        auto reset() -> void {
+            m_locked = false;
+            m_velocity = 0.0f;
+        }
+    };
+
+} // namespace mrover
@@ -0,0 +1,233 @@
+#include "autotune.hpp"
+#include "pidf.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <initializer_list>
+#include <iostream>
+#include <numbers>
+#include <random>
+
+using namespace mrover;
+
+// The relay experiment against a simulated brushed DC motor and gearbox, driven like the BMC drives one:
+// the output is sampled, held for a control period and applied one period late.
+// The ultimate gain and period it finds are checked against the ones worked out from the model's frequency response,
+// and the gains it hands back must close a loop that settles.
+
+namespace {
+
+    constexpr double PI = std::numbers::pi;
+    constexpr double CONTROL_DT = 1e-4; // the BMC control interrupt at its fastest
+    constexpr int SUBSTEPS = 4;
+
+    struct MotorModel {
+        double bus_voltage = 12.0;
+        double resistance = 1.0;    // ohms
+        double inductance = 1e-3;   // henries
+        double torque_constant = 0.02;
+        double inertia = 2e-5;      // kg m^2 at the rotor
+        double friction = 1e-5;     // N m s at the rotor
+        double gear_ratio = 50.0;
+        double load_torque = 0.0;   // N m at the output, e.g. gravity on an arm
+
+        // throttle to output velocity, with s in rad/s
+        [[nodiscard]] auto velocity_response(std::complex<double> const s) const -> std::complex<double> {
+            auto const electrical = inductance * s + resistance;
+            auto const mechanical = inertia * s + friction;
+            return bus_voltage * torque_constant / (electrical * mechanical + torque_constant * torque_constant) / gear_ratio;
+        }
+    };
+
+    struct MotorState {
+        double current{};
+        double rotor_velocity{};
+        double position{}; // output radians
+
+        [[nodiscard]] auto velocity(MotorModel const& model) const -> double {
+            return rotor_velocity / model.gear_ratio;
+        }
+    };
+
+    auto simulate(MotorModel const& model, MotorState& state, double const throttle) -> void {
+        double const voltage = std::clamp(throttle, -1.0, 1.0) * model.bus_voltage;
+        double const h = CONTROL_DT / SUBSTEPS;
+        for (int i = 0; i < SUBSTEPS; ++i) {
+            double const di = (voltage - model.resistance * state.current - model.torque_constant * state.rotor_velocity) / model.inductance;
+            double const torque = model.torque_constant * state.current - model.friction * state.rotor_velocity - model.load_torque / model.gear_ratio;
+            state.current += di * h;
+            state.rotor_velocity += torque / model.inertia * h;
+            state.position += state.rotor_velocity / model.gear_ratio * h;
+        }
+    }
+
+    enum class Loop { POSITION, VELOCITY };
+
+    // the sampled loop as the controller sees it: zero-order hold and one period of delay
+    auto loop_response(MotorModel const& model, Loop const loop, double const w) -> std::complex<double> {
+        std::complex<double> const s{0.0, w};
+        auto const hold = (1.0 - std::exp(-s * CONTROL_DT)) / (s * CONTROL_DT);
+        auto response = model.velocity_response(s) * hold * std::exp(-s * CONTROL_DT);
+        if (loop == Loop::POSITION) response /= s;
+        return response;
+    }
+
+    // where the loop lags by half a turn, by bisection on the phase, which falls monotonically here
+    auto analytic_ultimate(MotorModel const& model, Loop const loop) -> RelayAutotune::Result {
+        // unwrapped: the motor's two poles, half a period for the hold, one for the delay and a quarter turn for the integrator
+        auto const lag = [&](double const w) {
+            double const motor = std::arg(model.velocity_response({0.0, w}));
+            return motor - 1.5 * w * CONTROL_DT - (loop == Loop::POSITION ? PI / 2.0 : 0.0);
+        };
+        double low = 1.0, high = PI / CONTROL_DT;
+        for (int i = 0; i < 100; ++i) {
+            double const mid = std::sqrt(low * high);
+            (lag(mid) > -PI ? low : high) = mid;
+        }
+        return {
+                .ultimate_gain = static_cast<float>(1.0 / std::abs(loop_response(model, loop, low))),
+                .ultimate_period = static_cast<float>(2.0 * PI / low),
+        };
+    }
+
+    struct Experiment {
+        RelayAutotune::Status status;
+        RelayAutotune::Result result;
+    };
+
+    auto run_relay(MotorModel const& model, Loop const loop, float const setpoint, RelayAutotune::Options const& options,
+                   float const centre = 0.0f, double const noise = 0.0) -> Experiment {
+        std::mt19937 rng{7};
+        std::normal_distribution<double> measurement_noise{0.0, noise};
+        MotorState state{};
+        RelayAutotune autotune{options};
+        autotune.start(setpoint, centre);
+        double applied = 0.0;
+        while (autotune.status() == RelayAutotune::Status::RUNNING) {
+            double const input = (loop == Loop::POSITION ? state.position : state.velocity(model)) + (noise > 0.0 ? measurement_noise(rng) : 0.0);
+            double const output = autotune.step(static_cast<float>(input), static_cast<float>(CONTROL_DT));
+            // computed now, applied from the next period on
+            simulate(model, state, applied);
+            applied = output;
+        }
+        return {autotune.status(), autotune.result()};
+    }
+
+    auto relative_error(float const measured, float const expected) -> double {
+        return std::abs(measured - expected) / expected;
+    }
+
+    // a step through the tuned controller, as the BMC single loop runs it
+    auto step_response(MotorModel const& model, Loop const loop, PIDGains const& gains, float const step) -> std::pair<double, double> {
+        PIDF pidf;
+        pidf.with_p(gains.p).with_i(gains.i).with_d(gains.d).with_output_bound(-1.0, 1.0);
+        MotorState state{};
+        double applied = 0.0;
+        double overshoot = 0.0;
+        double settled_error = 0.0;
+        for (int tick = 0; tick * CONTROL_DT < 3.0; ++tick) {
+            double const input = loop == Loop::POSITION ? state.position : state.velocity(model);
+            double const output = pidf.calculate(static_cast<float>(input), step, static_cast<float>(CONTROL_DT));
+            simulate(model, state, applied);
+            applied = output;
+            overshoot = std::max(overshoot, (input - step) / step);
+            if (tick * CONTROL_DT >= 2.0) settled_error = std::max(settled_error, std::abs(input - step) / step);
+        }
+        return {overshoot, settled_error};
+    }
+
+    auto print(char const* name, RelayAutotune::Result const& measured, RelayAutotune::Result const& expected) -> void {
+        std::cout << name << ": ultimate gain " << measured.ultimate_gain << " against " << expected.ultimate_gain
+                  << ", period " << measured.ultimate_period * 1e3f << " ms against " << expected.ultimate_period * 1e3f << " ms\n";
+    }
+
+    // the describing function takes the input for a sine, but through an integrator it is closer to a triangle,
+    // whose peak overstates the fundamental by up to pi^2/8, so the gain comes out low, which is the safe side
+    auto check_ultimate(RelayAutotune::Result const& measured, RelayAutotune::Result const& expected, double const gain_tolerance, double const period_tolerance) -> void {
+        assert(measured.ultimate_gain < expected.ultimate_gain * 1.05f);
+        assert(relative_error(measured.ultimate_gain, expected.ultimate_gain) < gain_tolerance);
+        assert(relative_error(measured.ultimate_period, expected.ultimate_period) < period_tolerance);
+    }
+
+    auto test_against_model(Loop const loop, char const* name, float const setpoint, float const amplitude, std::initializer_list<TuningRule> const rules) -> void {
+        MotorModel const model;
+        RelayAutotune::Result const expected = analytic_ultimate(model, loop);
+        Experiment const experiment = run_relay(model, loop, setpoint, {.amplitude = amplitude, .hysteresis = 1e-4f});
+        assert(experiment.status == RelayAutotune::Status::DONE);
+        print(name, experiment.result, expected);
+        check_ultimate(experiment.result, expected, 0.2, 0.15);
+
+        // the tuned loop settles, with Tyreus-Luyben barely overshooting
+        for (TuningRule const rule: rules) {
+            auto const [overshoot, settled_error] = step_response(model, loop, tune_gains(experiment.result, rule), loop == Loop::POSITION ? 1.0f : 2.0f);
+            std::cout << "  rule " << static_cast<int>(rule) << ": overshoot " << overshoot * 100.0 << "%, settled within " << settled_error * 100.0 << "%\n";
+            assert(settled_error < 0.01);
+            assert(overshoot < 0.5);
+            if (rule == TuningRule::TYREUS_LUYBEN || rule == TuningRule::TYREUS_LUYBEN_PI) assert(overshoot < 0.1);
+        }
+    }
+
+    auto test_load() -> void {
+        // an arm held against gravity, the relay centre moves to the holding throttle
+        MotorModel loaded;
+        loaded.load_torque = 0.3;
+        RelayAutotune::Result const expected = analytic_ultimate(loaded, Loop::POSITION);
+        Experiment const experiment = run_relay(loaded, Loop::POSITION, 0.0f, {.amplitude = 0.2f, .hysteresis = 1e-4f});
+        assert(experiment.status == RelayAutotune::Status::DONE);
+        print("position under load", experiment.result, expected);
+        check_ultimate(experiment.result, expected, 0.2, 0.15);
+    }
+
+    auto test_noise() -> void {
+        // hysteresis at three deviations of the noise keeps the relay from chattering,
+        // the noise on the peaks widens the measured amplitude, again towards a lower gain, and the hysteresis slows the cycle
+        MotorModel const model;
+        RelayAutotune::Result const expected = analytic_ultimate(model, Loop::VELOCITY);
+        Experiment const experiment = run_relay(model, Loop::VELOCITY, 2.0f, {.amplitude = 0.6f, .hysteresis = 0.006f}, 0.0f, 0.002);
+        assert(experiment.status == RelayAutotune::Status::DONE);
+        print("velocity with noise", experiment.result, expected);
+        check_ultimate(experiment.result, expected, 0.5, 0.35);
+        assert(step_response(model, Loop::VELOCITY, tune_gains(experiment.result, TuningRule::ZIEGLER_NICHOLS_PI), 2.0f).second < 0.01);
+    }
+
+    auto test_no_oscillation() -> void {
+        // an output that cannot reach the setpoint never switches the relay back
+        MotorModel const model;
+        Experiment const experiment = run_relay(model, Loop::VELOCITY, 100.0f, {.amplitude = 0.2f, .timeout_s = 2.0f});
+        assert(experiment.status == RelayAutotune::Status::TIMED_OUT);
+
+        RelayAutotune autotune{{.amplitude = 0.2f}};
+        assert(autotune.step(0.0f, 0.001f) == 0.0f); // idle until started
+        autotune.start(1.0f);
+        assert(autotune.step(0.0f, 0.001f) == 0.2f);
+        autotune.abort();
+        assert(autotune.status() == RelayAutotune::Status::ABORTED);
+        assert(autotune.step(0.0f, 0.001f) == 0.0f);
+    }
+
+    auto test_rules() -> void {
+        constexpr RelayAutotune::Result result{.ultimate_gain = 10.0f, .ultimate_period = 0.5f};
+        constexpr PIDGains zn = tune_gains(result, TuningRule::ZIEGLER_NICHOLS);
+        static_assert(zn.p == 6.0f);
+        assert(std::abs(zn.i - 24.0f) < 1e-4f);  // p / (Tu / 2)
+        assert(std::abs(zn.d - 0.375f) < 1e-6f); // p * Tu / 8
+        constexpr PIDGains pi = tune_gains(result, TuningRule::TYREUS_LUYBEN_PI);
+        static_assert(pi.d == 0.0f);
+    }
+
+} // namespace
+
+auto main() -> int {
+    test_rules();
+    // a PI loop on an integrating plant only settles slowly, position gets the full PID
+    test_against_model(Loop::POSITION, "position", 0.0f, 0.2f, {TuningRule::ZIEGLER_NICHOLS, TuningRule::TYREUS_LUYBEN, TuningRule::NO_OVERSHOOT});
+    test_against_model(Loop::VELOCITY, "velocity", 2.0f, 0.3f, {TuningRule::ZIEGLER_NICHOLS, TuningRule::TYREUS_LUYBEN, TuningRule::ZIEGLER_NICHOLS_PI, TuningRule::TYREUS_LUYBEN_PI});
+    test_load();
+    test_noise();
+    test_no_oscillation();
+
+    std::cout << "autotune tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "encoder_fusion.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <numbers>
+
+using namespace mrover;
+
+// The BMC side of an ABS board: the quadrature position is recorded every control period, the absolute one arrives
+// a CAN round later stamped with when it was sampled. The fusion must see through that delay, move its offset
+// at the crossover time constant, and refuse samples older than its history.
+
+namespace {
+
+    constexpr double PI = std::numbers::pi;
+    constexpr uint32_t CONTROL_PERIOD_US = 500;  // BMC outer loop at 2 kHz
+    constexpr uint32_t ABS_PERIOD_US = 10'000;   // ABS publish rate
+    constexpr uint32_t ABS_DELAY_US = 20'250;    // sample to arrival over CAN, off the control grid so the history interpolates
+    constexpr float RELATIVE_OFFSET = 1.25f;     // where the quadrature count started, unknown to the fusion
+    constexpr float CROSSOVER_HZ = 2.0f;
+
+    // a joint swinging at 1 Hz, fast enough that 20 ms of delay is a large error
+    auto position(uint32_t const time_us) -> float {
+        return static_cast<float>(0.5 * std::sin(2.0 * PI * time_us * 1e-6));
+    }
+
+    auto relative(uint32_t const time_us) -> float {
+        return position(time_us) - RELATIVE_OFFSET;
+    }
+
+    // runs the joint for a while, correcting with each absolute sample as it arrives, and returns the worst offset error once locked
+    auto run(EncoderFusion& fusion, uint32_t const start_us, uint32_t const end_us, bool const stamp_on_arrival) -> float {
+        float worst = 0.0f;
+        for (uint32_t now = start_us; now < end_us; now += CONTROL_PERIOD_US) {
+            fusion.record(now, relative(now));
+            if (now % ABS_PERIOD_US != 0 || now < start_us + ABS_DELAY_US) continue;
+            uint32_t const sample_us = now - ABS_DELAY_US;
+            bool const accepted = fusion.correct(stamp_on_arrival ? now : sample_us, position(sample_us));
+            assert(accepted);
+            worst = std::fmax(worst, std::fabs(fusion.offset() - RELATIVE_OFFSET));
+        }
+        return worst;
+    }
+
+    auto test_latency() -> void {
+        // the offset is constant, so any error it shows is delay the history did not take out
+        EncoderFusion fused{CROSSOVER_HZ};
+        float const fused_error = run(fused, 1'000'000, 3'000'000, false);
+        EncoderFusion naive{CROSSOVER_HZ};
+        float const naive_error = run(naive, 1'000'000, 3'000'000, true);
+        std::cout << "offset error with the delay removed " << fused_error << ", paired on arrival " << naive_error << '\n';
+        assert(fused.locked());
+        assert(fused_error < 1e-4f);
+        assert(naive_error > 0.02f);
+    }
+
+    auto test_time_constant() -> void {
+        // the ABS board is re-zeroed while the joint stands still, the offset then follows the absolute reading
+        // as a first-order lag at the crossover
+        constexpr float STEP = 0.1f;
+        constexpr uint32_t STEP_US = 1'000'000 - ABS_DELAY_US; // an absolute sample, the first to see the step
+        EncoderFusion fusion{CROSSOVER_HZ};
+        double const tau_s = 1.0 / (2.0 * PI * CROSSOVER_HZ);
+        for (uint32_t now = 0; now < 2'000'000; now += CONTROL_PERIOD_US) {
+            fusion.record(now, 0.0f);
+            if (now % ABS_PERIOD_US != 0 || now < ABS_DELAY_US) continue;
+            uint32_t const sample_us = now - ABS_DELAY_US;
+            bool const accepted = fusion.correct(sample_us, sample_us >= STEP_US ? STEP : 0.0f);
+            assert(accepted);
+            if (sample_us < STEP_US) {
+                assert(fusion.offset() == 0.0f);
+                continue;
+            }
+            // the first correction to see the step already moves by a whole period
+            double const expected = STEP * (1.0 - std::exp(-static_cast<double>(sample_us + ABS_PERIOD_US - STEP_US) * 1e-6 / tau_s));
+            assert(std::fabs(fusion.offset() - expected) < 1e-3 * STEP);
+        }
+        std::cout << "offset after the step " << fusion.offset() << " against " << STEP << '\n';
+        assert(std::fabs(fusion.offset() - STEP) < 1e-3f);
+    }
+
+    auto test_stale_sample() -> void {
+        EncoderFusion fusion{CROSSOVER_HZ};
+        constexpr uint32_t END_US = 1'000'000;
+        for (uint32_t now = 0; now < END_US; now += CONTROL_PERIOD_US) {
+            fusion.record(now, relative(now));
+        }
+        // older than the 128 ms of history, dropped without touching the offset
+        assert(!fusion.correct(END_US - 200'000, position(END_US - 200'000)));
+        assert(!fusion.locked());
+        // within it, taken
+        assert(fusion.correct(END_US - 100'000, position(END_US - 100'000)));
+        assert(std::fabs(fusion.offset() - RELATIVE_OFFSET) < 1e-4f);
+        float const offset = fusion.offset();
+        assert(!fusion.correct(END_US - 200'000, 100.0f));
+        assert(fusion.offset() == offset);
+    }
+
+} // namespace
+
+auto main() -> int {
+    test_latency();
+    test_time_constant();
+    test_stale_sample();
+
+    std::cout << "encoder fusion tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "filtering.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace mrover;
+
+// host timing only, it ranks the paths against each other, the Cortex-M4F numbers come from the DWT task diagnostics
+namespace {
+
+    constexpr std::size_t BLOCK = 256;
+    constexpr int BLOCKS = 40'000;
+
+    template<typename F>
+    auto time_per_sample(char const* name, F&& run) -> void {
+        auto const start = std::chrono::steady_clock::now();
+        run();
+        auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << elapsed / (static_cast<double>(BLOCK) * BLOCKS) << " ns per sample\n";
+    }
+
+} // namespace
+
+auto main() -> int {
+    std::vector<float> input(BLOCK);
+    for (std::size_t n = 0; n < BLOCK; ++n) input[n] = std::sin(0.05f * static_cast<float>(n));
+    std::vector<float> block(BLOCK);
+    [[maybe_unused]] float volatile sink{};
+
+    {
+        ButterworthFilter<float, 4, FilterPass::LOW, 50.0, 1000.0> filter;
+        time_per_sample("4th order butterworth, per sample", [&] {
+            for (int b = 0; b < BLOCKS; ++b) {
+                for (float const sample: input) sink = filter.process(sample);
+            }
+        });
+    }
+    {
+        ButterworthFilter<float, 4, FilterPass::LOW, 50.0, 1000.0> filter;
+        time_per_sample("4th order butterworth, process(span)", [&] {
+            for (int b = 0; b < BLOCKS; ++b) {
+                block = input;
+                filter.process(std::span{block});
+                sink = filter.get_filtered();
+            }
+        });
+    }
+    {
+        RunningMeanFilter<float, 64> filter;
+        time_per_sample("64 sample running mean, read after every reading", [&] {
+            for (int b = 0; b < BLOCKS; ++b) {
+                for (float const sample: input) {
+                    filter.add_reading(sample);
+                    sink = filter.get_filtered();
+                }
+            }
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "filtering.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <vector>
+
+using namespace mrover;
+
+namespace {
+
+    constexpr double SAMPLE_HZ = 1000.0;
+
+    // |H| of the designed cascade at a frequency, straight from the coefficients
+    template<std::size_t N>
+    auto magnitude(std::array<BiquadCoefficients, N> const& sections, double const hz) -> double {
+        std::complex<double> const z1 = std::polar(1.0, -2.0 * detail::PI * hz / SAMPLE_HZ);
+        std::complex<double> const z2 = z1 * z1;
+        std::complex<double> h{1.0};
+        for (auto const& [b0, b1, b2, a1, a2]: sections) {
+            h *= (b0 + b1 * z1 + b2 * z2) / (1.0 + a1 * z1 + a2 * z2);
+        }
+        return std::abs(h);
+    }
+
+    auto db(double const gain) -> double {
+        return 20.0 * std::log10(gain);
+    }
+
+    // steady-state amplitude the running filter passes a sine through with,
+    // correlated against the input over a whole number of periods once the start-up transient died out
+    template<typename Filter>
+    auto measured_gain(Filter filter, double const hz) -> double {
+        double in_phase = 0.0;
+        double quadrature = 0.0;
+        constexpr int SETTLE = 10000;
+        constexpr int WINDOW = 10000;
+        for (int n = 0; n < SETTLE + WINDOW; ++n) {
+            double const phase = 2.0 * detail::PI * hz * n / SAMPLE_HZ;
+            double const out = filter.process(static_cast<float>(std::sin(phase)));
+            if (n < SETTLE) continue;
+            in_phase += out * std::sin(phase);
+            quadrature += out * std::cos(phase);
+        }
+        return 2.0 * std::hypot(in_phase, quadrature) / WINDOW;
+    }
+
+    auto test_constexpr_math() -> void {
+        for (double x = -10.0; x < 10.0; x += 0.01) {
+            assert(std::fabs(detail::sin(x) - std::sin(x)) < 1e-12);
+            assert(std::fabs(detail::cos(x) - std::cos(x)) < 1e-12);
+        }
+        static_assert(detail::sin(detail::PI / 2.0) > 0.999999999);
+    }
+
+    auto test_butterworth_lowpass() -> void {
+        constexpr auto sections = butterworth<4>(FilterPass::LOW, 50.0, SAMPLE_HZ);
+        assert(std::fabs(db(magnitude(sections, 0.0))) < 1e-9);
+        assert(std::fabs(db(magnitude(sections, 50.0)) + 3.0103) < 1e-6);
+        // maximally flat passband
+        assert(std::fabs(db(magnitude(sections, 10.0))) < 0.01);
+        // 80 dB/decade past the cutoff, the bilinear transform only adds attenuation
+        assert(db(magnitude(sections, 200.0)) < -48.0);
+        for (double hz = 1.0; hz < SAMPLE_HZ / 2.0; hz += 1.0) {
+            assert(magnitude(sections, hz) <= magnitude(sections, hz - 1.0) + 1e-12);
+        }
+
+        ButterworthFilter<float, 4, FilterPass::LOW, 50.0, SAMPLE_HZ> filter;
+        for (double const hz: {5.0, 50.0, 100.0, 200.0}) {
+            double const measured = measured_gain(filter, hz);
+            std::cout << "4th order low-pass at " << hz << " Hz: " << db(measured) << " dB, designed " << db(magnitude(sections, hz)) << " dB\n";
+            assert(std::fabs(measured - magnitude(sections, hz)) < 1e-3);
+        }
+    }
+
+    auto test_butterworth_highpass() -> void {
+        constexpr auto sections = butterworth<3>(FilterPass::HIGH, 20.0, SAMPLE_HZ);
+        static_assert(sections.size() == 2);
+        assert(magnitude(sections, 0.0) < 1e-9);
+        assert(std::fabs(db(magnitude(sections, 20.0)) + 3.0103) < 1e-6);
+        assert(std::fabs(db(magnitude(sections, SAMPLE_HZ / 2.0))) < 1e-6);
+        assert(db(magnitude(sections, 2.0)) < -59.0);
+
+        ButterworthFilter<float, 3, FilterPass::HIGH, 20.0, SAMPLE_HZ> filter;
+        assert(std::fabs(measured_gain(filter, 20.0) - magnitude(sections, 20.0)) < 1e-3);
+        assert(std::fabs(measured_gain(filter, 200.0) - 1.0) < 1e-3);
+    }
+
+    auto test_notch() -> void {
+        constexpr auto sections = notch(60.0, 5.0, SAMPLE_HZ);
+        assert(magnitude(sections, 60.0) < 1e-9);
+        // the -3 dB band is 12 Hz wide around the center
+        assert(std::fabs(db(magnitude(sections, 60.0 + 6.0)) + 3.0) < 0.5);
+        assert(std::fabs(db(magnitude(sections, 10.0))) < 0.1);
+        assert(std::fabs(db(magnitude(sections, 300.0))) < 0.1);
+
+        NotchFilter<float, 60.0, 5.0, SAMPLE_HZ> filter;
+        std::cout << "notch at 60 Hz: " << db(measured_gain(filter, 60.0)) << " dB\n";
+        assert(measured_gain(filter, 60.0) < 1e-3);
+    }
+
+    // the block path is the per-sample path, reordered
+    auto test_block_matches_samples() -> void {
+        ButterworthFilter<float, 5, FilterPass::LOW, 30.0, SAMPLE_HZ> per_sample;
+        ButterworthFilter<float, 5, FilterPass::LOW, 30.0, SAMPLE_HZ> block;
+        std::vector<float> samples(1000);
+        for (std::size_t n = 0; n < samples.size(); ++n) samples[n] = static_cast<float>(std::sin(0.3 * n) + 0.5 * std::cos(0.01 * n));
+        std::vector<float> expected(samples.size());
+        for (std::size_t n = 0; n < samples.size(); ++n) expected[n] = per_sample.process(samples[n]);
+        // uneven blocks, state carries across
+        block.process(std::span{samples}.first(333));
+        block.process(std::span{samples}.subspan(333));
+        for (std::size_t n = 0; n < samples.size(); ++n) assert(samples[n] == expected[n]);
+        assert(block.get_filtered() == per_sample.get_filtered());
+    }
+
+    auto test_reset_steady_state() -> void {
+        ButterworthFilter<float, 4, FilterPass::LOW, 10.0, SAMPLE_HZ> filter;
+        filter.reset(2.5f);
+        // within the float rounding of a 10 Hz cutoff, where it would otherwise start from zero
+        for (int n = 0; n < 1000; ++n) assert(std::fabs(filter.process(2.5f) - 2.5f) < 1e-3f);
+        filter.clear();
+        assert(filter.get_filtered() == 0.0f);
+    }
+
+    auto test_running_mean() -> void {
+        RunningMeanFilter<float, 8> filter;
+        for (int n = 1; n <= 8; ++n) filter.add_reading(static_cast<float>(n));
+        assert(filter.get_filtered() == 4.5f);
+        filter.add_reading(17.0f);
+        assert(filter.get_filtered() == 6.5f);
+        filter.clear();
+        assert(filter.get_filtered() == 0.0f);
+        filter.add_reading(8.0f);
+        assert(filter.get_filtered() == 1.0f);
+
+        // no drift from rounding after millions of readings
+        RunningMeanFilter<float, 16> noisy;
+        for (int n = 0; n < 5'000'000; ++n) noisy.add_reading(n % 2 ? 1000.1f : 0.3f);
+        for (int n = 0; n < 16; ++n) noisy.add_reading(0.25f);
+        assert(std::fabs(noisy.get_filtered() - 0.25f) < 1e-6f);
+
+        RunningMeanFilter<int, 4> integers;
+        for (int const reading: {4, 8, 12, 16, 20}) integers.add_reading(reading);
+        assert(integers.get_filtered() == 14);
+    }
+
+} // namespace
+
+auto main() -> int {
+    test_constexpr_math();
+    test_butterworth_lowpass();
+    test_butterworth_highpass();
+    test_notch();
+    test_block_matches_samples();
+    test_reset_steady_state();
+    test_running_mean();
+    std::cout << "all filtering tests passed\n";
+    return 0;
+}
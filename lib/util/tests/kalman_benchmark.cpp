@@ -0,0 +1,75 @@
+#include "kalman.hpp"
+
+#include <Eigen/Dense>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace mrover;
+
+// host timing only, it ranks the variants against each other, the Cortex-M4F numbers come from the DWT task diagnostics
+namespace {
+
+    constexpr int ITERATIONS = 10'000'000;
+    constexpr float DT = 0.0002f;
+    constexpr int SAMPLES = 1024;
+
+    // the same three state filter on Eigen's fixed-size types, the usual choice off the MCU
+    struct EigenKinematic {
+        Eigen::Vector3f x = Eigen::Vector3f::Zero();
+        Eigen::Matrix3f p = Eigen::Matrix3f::Identity();
+        Eigen::Matrix3f f;
+        Eigen::Matrix3f q;
+        Eigen::RowVector3f h{1.0f, 0.0f, 0.0f};
+        float r = 1e-6f;
+
+        EigenKinematic() {
+            float const dt2 = DT * DT;
+            float const dt3 = dt2 * DT;
+            f << 1.0f, DT, dt2 / 2.0f, 0.0f, 1.0f, DT, 0.0f, 0.0f, 1.0f;
+            q << dt3 * dt2 / 20.0f, dt2 * dt2 / 8.0f, dt3 / 6.0f, dt2 * dt2 / 8.0f, dt3 / 3.0f, dt2 / 2.0f, dt3 / 6.0f, dt2 / 2.0f, DT;
+            q *= 100.0f;
+        }
+
+        auto update(float const z) -> void {
+            x = f * x;
+            p = f * p * f.transpose() + q;
+            Eigen::Vector3f const pht = p * h.transpose();
+            Eigen::Vector3f const k = pht / (h.dot(pht) + r);
+            x += k * (z - h.dot(x));
+            Eigen::Matrix3f const i_kh = Eigen::Matrix3f::Identity() - k * h;
+            p = i_kh * p * i_kh.transpose() + k * r * k.transpose();
+        }
+    };
+
+    template<typename Update>
+    auto benchmark(char const* name, Update&& update) -> void {
+        // inputs precomputed, so only the filter is timed
+        float inputs[SAMPLES];
+        for (int i = 0; i < SAMPLES; ++i) inputs[i] = std::sin(static_cast<float>(i) * 0.01f);
+
+        [[maybe_unused]] float volatile sink{};
+        auto const start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) sink = update(inputs[i % SAMPLES]);
+        auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << elapsed / ITERATIONS << " ns per predict and update\n";
+    }
+
+} // namespace
+
+auto main() -> int {
+    KinematicEstimator<float> estimator{100.0f, 1e-6f};
+    estimator.reset(0.0f, 1.0f, 1.0f, 1.0f);
+    benchmark("KinematicEstimator<float>", [&](float const z) {
+        estimator.update(z, DT);
+        return estimator.velocity();
+    });
+
+    EigenKinematic eigen;
+    benchmark("Eigen Matrix3f", [&](float const z) {
+        eigen.update(z);
+        return eigen.x[1];
+    });
+    return 0;
+}
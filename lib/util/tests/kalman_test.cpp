@@ -0,0 +1,187 @@
+#include "kalman.hpp"
+
+#include <Eigen/Dense>
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace mrover;
+
+// checked against the textbook equations in Eigen, which the boards cannot carry, in double precision
+namespace {
+
+    std::mt19937 rng{42};
+
+    template<typename T, std::size_t R, std::size_t C>
+    auto to_eigen(Matrix<T, R, C> const& m) -> Eigen::Matrix<double, R, C> {
+        Eigen::Matrix<double, R, C> e;
+        for (std::size_t r = 0; r < R; ++r) {
+            for (std::size_t c = 0; c < C; ++c) e(r, c) = static_cast<double>(m(r, c));
+        }
+        return e;
+    }
+
+    template<typename T, std::size_t R, std::size_t C>
+    auto random_matrix() -> Matrix<T, R, C> {
+        std::uniform_real_distribution<double> dist{-1.0, 1.0};
+        Matrix<T, R, C> m;
+        for (std::size_t r = 0; r < R; ++r) {
+            for (std::size_t c = 0; c < C; ++c) m(r, c) = static_cast<T>(dist(rng));
+        }
+        return m;
+    }
+
+    // A A^T plus the diagonal is comfortably positive definite
+    template<typename T, std::size_t N>
+    auto random_spd() -> Matrix<T, N, N> {
+        Matrix<T, N, N> const a = random_matrix<T, N, N>();
+        return a * a.transpose() + Matrix<T, N, N>::identity() * static_cast<T>(0.5);
+    }
+
+    template<typename A, typename B>
+    auto max_difference(A const& a, B const& b) -> double {
+        return (a - b).cwiseAbs().maxCoeff();
+    }
+
+    auto test_matrix_ops() -> void {
+        for (int trial = 0; trial < 100; ++trial) {
+            auto const a = random_matrix<double, 3, 4>();
+            auto const b = random_matrix<double, 4, 2>();
+            assert(max_difference(to_eigen(a * b), to_eigen(a) * to_eigen(b)) < 1e-12);
+            assert(max_difference(to_eigen(a.transpose()), to_eigen(a).transpose()) == 0.0);
+            assert(max_difference(to_eigen(a + a * 2.0), to_eigen(a) * 3.0) < 1e-12);
+
+            auto const v = random_matrix<double, 4, 1>();
+            assert(max_difference(to_eigen(a * v), to_eigen(a) * to_eigen(v)) < 1e-12);
+        }
+
+        static_assert(Matrix<int, 2, 2>{1, 2, 3, 4} * Matrix<int, 2, 2>::identity() == Matrix<int, 2, 2>{1, 2, 3, 4});
+        static_assert((Matrix<int, 1, 2>{1, 2} * Matrix<int, 2, 1>{3, 4})(0, 0) == 11);
+    }
+
+    template<std::size_t N>
+    auto test_inverse() -> void {
+        for (int trial = 0; trial < 100; ++trial) {
+            auto const a = random_spd<double, N>();
+            auto const inverse = inverse_spd(a);
+            assert(inverse);
+            assert(max_difference(to_eigen(*inverse), to_eigen(a).inverse()) < 1e-9);
+        }
+        // a negative eigenvalue is caught instead of producing garbage
+        Matrix<double, N, N> indefinite = Matrix<double, N, N>::identity();
+        indefinite(N - 1, N - 1) = -1.0;
+        assert(!inverse_spd(indefinite));
+        assert(!inverse_spd(Matrix<double, N, N>::zero()));
+    }
+
+    // textbook form: K = P H^T (H P H^T + R)^-1, P = (I - K H) P
+    template<std::size_t N, std::size_t M>
+    struct Reference {
+        Eigen::Matrix<double, N, 1> x;
+        Eigen::Matrix<double, N, N> p, f, q;
+        Eigen::Matrix<double, M, N> h;
+        Eigen::Matrix<double, M, M> r;
+
+        auto predict() -> void {
+            x = f * x;
+            p = f * p * f.transpose() + q;
+        }
+
+        auto update(Eigen::Matrix<double, M, 1> const& z) -> void {
+            Eigen::Matrix<double, M, M> const s = h * p * h.transpose() + r;
+            Eigen::Matrix<double, N, M> const k = p * h.transpose() * s.inverse();
+            x += k * (z - h * x);
+            p = (Eigen::Matrix<double, N, N>::Identity() - k * h) * p;
+        }
+    };
+
+    template<typename T, std::size_t N, std::size_t M>
+    auto test_against_reference(double const tolerance) -> double {
+        // a random but stable system, the transition's eigenvalues are inside the unit circle
+        Matrix<T, N, N> const f = (Matrix<T, N, N>::identity() + random_matrix<T, N, N>() * static_cast<T>(0.05)) * static_cast<T>(0.8);
+        Matrix<T, N, N> const q = random_spd<T, N>() * static_cast<T>(0.01);
+        Matrix<T, M, N> const h = random_matrix<T, M, N>();
+        Matrix<T, M, M> const r = random_spd<T, M>() * static_cast<T>(0.1);
+        Matrix<T, N, 1> const x0 = random_matrix<T, N, 1>();
+        Matrix<T, N, N> const p0 = Matrix<T, N, N>::identity();
+
+        KalmanFilter<T, N, M> filter{f, q, h, r};
+        filter.reset(x0, p0);
+        Reference<N, M> reference{to_eigen(x0), to_eigen(p0), to_eigen(f), to_eigen(q), to_eigen(h), to_eigen(r)};
+
+        double worst = 0.0;
+        for (int step = 0; step < 1000; ++step) {
+            Matrix<T, M, 1> const z = random_matrix<T, M, 1>();
+            filter.predict();
+            assert(filter.update(z));
+            reference.predict();
+            reference.update(to_eigen(z));
+
+            worst = std::max({worst,
+                              max_difference(to_eigen(filter.state()), reference.x),
+                              max_difference(to_eigen(filter.covariance()), reference.p)});
+        }
+        assert(worst < tolerance);
+        return worst;
+    }
+
+    auto test_kinematic_tracking() -> void {
+        // a sine sampled at 1 kHz through 1 mm of noise
+        constexpr double DT = 0.001;
+        constexpr double NOISE = 1e-3;
+        std::normal_distribution<double> noise{0.0, NOISE};
+        KinematicEstimator<float> estimator{100.0f, static_cast<float>(NOISE * NOISE)};
+        estimator.reset(0.0f, 1.0f, 1.0f, 1.0f);
+
+        double position_sq = 0.0, velocity_sq = 0.0, difference_sq = 0.0;
+        double previous = 0.0;
+        int n = 0;
+        for (int step = 1; step <= 10000; ++step) {
+            double const t = step * DT;
+            double const measured = std::sin(t) + noise(rng);
+            estimator.update(static_cast<float>(measured), static_cast<float>(DT));
+            if (step > 1000) {
+                position_sq += std::pow(estimator.position() - std::sin(t), 2);
+                velocity_sq += std::pow(estimator.velocity() - std::cos(t), 2);
+                difference_sq += std::pow((measured - previous) / DT - std::cos(t), 2);
+                ++n;
+            }
+            previous = measured;
+        }
+        double const position_rms = std::sqrt(position_sq / n);
+        double const velocity_rms = std::sqrt(velocity_sq / n);
+        double const difference_rms = std::sqrt(difference_sq / n);
+        std::cout << "kinematic estimator: position rms " << position_rms << ", velocity rms " << velocity_rms
+                  << " against " << difference_rms << " by differencing\n";
+        assert(position_rms < NOISE / 2.0);
+        assert(velocity_rms < difference_rms / 20.0);
+    }
+
+} // namespace
+
+auto main() -> int {
+    test_matrix_ops();
+    test_inverse<1>();
+    test_inverse<2>();
+    test_inverse<3>();
+    test_inverse<6>();
+
+    for (int trial = 0; trial < 20; ++trial) {
+        test_against_reference<double, 3, 1>(1e-9);
+        test_against_reference<double, 4, 2>(1e-9);
+        test_against_reference<double, 6, 3>(1e-9);
+    }
+    double worst = 0.0;
+    for (int trial = 0; trial < 20; ++trial) {
+        worst = std::max(worst, test_against_reference<float, 3, 1>(1e-3));
+        worst = std::max(worst, test_against_reference<float, 4, 2>(1e-3));
+    }
+    std::cout << "float against the double reference: worst difference " << worst << "\n";
+
+    test_kinematic_tracking();
+
+    std::cout << "kalman tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "pidf.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <type_traits>
+
+using namespace mrover;
+
+// host timing only, it ranks the variants against each other, the Cortex-M4F numbers come from the DWT task diagnostics
+namespace {
+
+    constexpr int ITERATIONS = 10'000'000;
+    constexpr float DT = 0.0002f;
+
+    template<typename T>
+    auto to_scalar(float const value) -> T {
+        if constexpr (std::is_same_v<T, float>) {
+            return value;
+        } else {
+            return T::from_float(value);
+        }
+    }
+
+    template<typename T>
+    auto to_float(T const value) -> float {
+        if constexpr (std::is_same_v<T, float>) {
+            return value;
+        } else {
+            return value.to_float();
+        }
+    }
+
+    template<typename T>
+    auto benchmark(char const* name) -> void {
+        BasicPIDF<T> pidf;
+        pidf.with_p(0.8f).with_i(2.0f).with_d(0.001f).with_ff(0.1f).with_d_filter(0.001f).with_output_bound(-1.0f, 1.0f);
+
+        // inputs precomputed, so only the controller is timed
+        constexpr int SAMPLES = 1024;
+        T inputs[SAMPLES];
+        for (int i = 0; i < SAMPLES; ++i) inputs[i] = to_scalar<T>(0.5f * std::sin(static_cast<float>(i) * 0.01f));
+        T const target = to_scalar<T>(0.25f);
+
+        [[maybe_unused]] float volatile sink{};
+        auto const start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            T const output = pidf.calculate(inputs[i % SAMPLES], target, DT);
+            sink = to_float(output);
+        }
+        auto const elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << elapsed / ITERATIONS << " ns per call\n";
+    }
+
+} // namespace
+
+auto main() -> int {
+    benchmark<float>("float");
+    benchmark<Q31>("Q31");
+    benchmark<Q15>("Q15");
+    return 0;
+}
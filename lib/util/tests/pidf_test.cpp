@@ -0,0 +1,286 @@
+#include "pidf.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+using namespace mrover;
+
+namespace legacy {
+
+    // the float-only controller this one replaced, kept to check the two agree where they should
+    struct PIDF {
+    private:
+        // gains
+        float m_kp{0.0};
+        float m_ki{0.0};
+        float m_kd{0.0};
+        float m_kff{0.0};
+
+        // settings
+        float m_dead_band{0.0};
+        float m_out_min{0.0};
+        float m_out_max{0.0};
+
+        // input bounds
+        std::optional<std::pair<float, float>> m_input_bound;
+
+        // internal state
+        float m_total_error{0.0};
+        float m_last_error{0.0};
+
+    public:
+        /**
+         * Calculates the next output signal.
+         *
+         * @param input     Current sensor reading
+         * @param target    Desired setpoint
+         * @param dt        Time delta since last call (seconds)
+         * @return          Clamped output value
+         */
+        auto calculate(float const input, float const target, float const dt) -> float {
+            if (dt <= 0.0) return m_out_min;
+
+            float error = target - input;
+
+            // continuous input wrapping
+            if (m_input_bound) {
+                auto [in_min, in_max] = m_input_bound.value();
+                if (float const range = in_max - in_min; std::abs(error) > range / 2.0) {
+                    if (error > 0) {
+                        error -= range;
+                    } else {
+                        error += range;
+                    }
+                }
+            }
+
+            // anti-windup
+            if (float const p_term = m_kp * error; p_term > m_out_min && p_term < m_out_max) {
+                m_total_error += error * dt;
+            } else {
+                m_total_error = 0.0;
+            }
+
+            // deadband
+            float const error_for_p = (std::abs(error) < m_dead_band) ? 0.0 : error;
+
+            // term calcs
+            float const d_term = m_kd * (error - m_last_error) / dt;
+            float const i_term = m_ki * m_total_error;
+            float const ff_term = m_kff * target;
+
+            // calc result
+            float const result = (m_kp * error_for_p) + i_term + d_term + ff_term;
+
+            m_last_error = error;
+
+            return std::clamp(result, m_out_min, m_out_max);
+        }
+
+        auto with_p(float const p) -> PIDF& {
+            m_kp = p;
+            return *this;
+        }
+
+        auto with_i(float const i) -> PIDF& {
+            m_ki = i;
+            return *this;
+        }
+
+        auto with_d(float const d) -> PIDF& {
+            m_kd = d;
+            return *this;
+        }
+
+        auto with_ff(float const ff) -> PIDF& {
+            m_kff = ff;
+            return *this;
+        }
+
+        auto with_dead_band(float const dead_band) -> PIDF& {
+            m_dead_band = dead_band;
+            return *this;
+        }
+
+        auto with_input_bound(float min, float max) -> PIDF& {
+            m_input_bound = {min, max};
+            return *this;
+        }
+
+        auto with_output_bound(float const min, float const max) -> PIDF& {
+            m_out_min = min;
+            m_out_max = max;
+            return *this;
+        }
+    };
+
+} // namespace legacy
+
+namespace {
+
+    constexpr float DT = 0.001f;
+
+    // first-order plant, output follows the input with a 50 ms lag
+    struct Plant {
+        float y{};
+
+        auto step(float const u) -> float {
+            y += (u - y) * DT / 0.05f;
+            return y;
+        }
+    };
+
+    template<typename Controller>
+    auto configure(Controller& pidf, float const kp, float const ki, float const kd, float const kff) -> void {
+        pidf.with_p(kp).with_i(ki).with_d(kd).with_ff(kff).with_output_bound(-1.0f, 1.0f);
+    }
+
+    // matches the old controller exactly while the output stays within its bounds
+    auto test_float_matches_legacy() -> void {
+        PIDF pidf;
+        legacy::PIDF reference;
+        configure(pidf, 0.8f, 2.0f, 0.0f, 0.1f);
+        configure(reference, 0.8f, 2.0f, 0.0f, 0.1f);
+
+        Plant plant;
+        float max_diff = 0.0f;
+        for (int i = 0; i < 5000; ++i) {
+            float const target = i < 2500 ? 0.5f : -0.3f;
+            float const u = pidf.calculate(plant.y, target, DT);
+            float const u_ref = reference.calculate(plant.y, target, DT);
+            assert(u > -1.0f && u < 1.0f);
+            max_diff = std::max(max_diff, std::fabs(u - u_ref));
+            plant.step(u);
+        }
+        std::cout << "float vs legacy, PI: max difference " << max_diff << "\n";
+        assert(max_diff < 1e-4f);
+    }
+
+    // the derivatives agree under a constant target, once there is a previous measurement to difference
+    auto test_derivative_matches_legacy() -> void {
+        PIDF pidf;
+        legacy::PIDF reference;
+        configure(pidf, 0.5f, 1.0f, 0.002f, 0.0f);
+        configure(reference, 0.5f, 1.0f, 0.002f, 0.0f);
+
+        Plant plant;
+        float max_diff = 0.0f;
+        // the old controller kicks on its first call, differencing the error against zero
+        float const first = reference.calculate(plant.y, 0.4f, DT);
+        pidf.calculate(plant.y, 0.4f, DT);
+        plant.step(first);
+        for (int i = 0; i < 3000; ++i) {
+            float const u = pidf.calculate(plant.y, 0.4f, DT);
+            float const u_ref = reference.calculate(plant.y, 0.4f, DT);
+            max_diff = std::max(max_diff, std::fabs(u - u_ref));
+            plant.step(u_ref);
+        }
+        std::cout << "float vs legacy, PID: max difference " << max_diff << "\n";
+        assert(max_diff < 1e-4f);
+    }
+
+    auto test_input_wrapping() -> void {
+        PIDF pidf;
+        legacy::PIDF reference;
+        configure(pidf, 0.1f, 0.0f, 0.0f, 0.0f);
+        configure(reference, 0.1f, 0.0f, 0.0f, 0.0f);
+        pidf.with_input_bound(-M_PI, M_PI);
+        reference.with_input_bound(-M_PI, M_PI);
+        // 3.0 to -3.0 is shorter forward across the seam
+        float const u = pidf.calculate(3.0f, -3.0f, DT);
+        assert(u > 0.0f);
+        assert(std::fabs(u - reference.calculate(3.0f, -3.0f, DT)) < 1e-6f);
+    }
+
+    template<typename Fixed, typename Controller>
+    auto run_fixed(float const tolerance, char const* name) -> void {
+        PIDF pidf;
+        Controller fixed;
+        configure(pidf, 0.8f, 2.0f, 0.001f, 0.1f);
+        configure(fixed, 0.8f, 2.0f, 0.001f, 0.1f);
+        pidf.with_d_filter(0.005f);
+        fixed.with_d_filter(0.005f);
+
+        Plant plant;
+        float max_diff = 0.0f;
+        for (int i = 0; i < 5000; ++i) {
+            float const target = i < 2500 ? 0.5f : -0.3f;
+            float const u = pidf.calculate(plant.y, target, DT);
+            float const u_fixed = fixed.calculate(Fixed::from_float(plant.y), Fixed::from_float(target), DT).to_float();
+            max_diff = std::max(max_diff, std::fabs(u - u_fixed));
+            plant.step(u);
+        }
+        std::cout << name << " vs float: max difference " << max_diff << "\n";
+        assert(max_diff < tolerance);
+    }
+
+    // the setpoint is not differentiated, a step only moves the proportional term
+    auto test_no_derivative_kick() -> void {
+        PIDF pidf;
+        configure(pidf, 0.0f, 0.0f, 1.0f, 0.0f);
+        pidf.calculate(0.2f, 0.0f, DT);
+        assert(pidf.calculate(0.2f, 0.9f, DT) == 0.0f);
+    }
+
+    auto test_derivative_filter() -> void {
+        PIDF raw;
+        PIDF filtered;
+        configure(raw, 0.0f, 0.0f, 0.001f, 0.0f);
+        configure(filtered, 0.0f, 0.0f, 0.001f, 0.0f);
+        filtered.with_d_filter(0.01f);
+
+        // measurement noise alternating every sample
+        float raw_peak = 0.0f;
+        float filtered_peak = 0.0f;
+        for (int i = 0; i < 1000; ++i) {
+            float const noise = i % 2 ? 0.01f : -0.01f;
+            raw_peak = std::max(raw_peak, std::fabs(raw.calculate(noise, 0.0f, DT)));
+            filtered_peak = std::max(filtered_peak, std::fabs(filtered.calculate(noise, 0.0f, DT)));
+        }
+        std::cout << "derivative noise peak raw " << raw_peak << ", filtered " << filtered_peak << "\n";
+        assert(filtered_peak < raw_peak / 10.0f);
+    }
+
+    // after a long saturation the output comes off the bound as soon as the error turns
+    auto test_back_calculation() -> void {
+        PIDF pidf;
+        configure(pidf, 0.5f, 5.0f, 0.0f, 0.0f);
+        for (int i = 0; i < 5000; ++i) assert(pidf.calculate(0.0f, 10.0f, DT) == 1.0f);
+        assert(pidf.calculate(0.0f, -0.1f, DT) < 1.0f);
+
+        legacy::PIDF reference;
+        configure(reference, 0.5f, 5.0f, 0.0f, 0.0f);
+        for (int i = 0; i < 5000; ++i) reference.calculate(0.0f, 1.5f, DT);
+        // the old clamp only stopped integrating while the proportional term alone saturated, below that it winds up
+        assert(reference.calculate(0.0f, -0.1f, DT) == 1.0f);
+    }
+
+    auto test_fixed_saturation() -> void {
+        assert(Q31::max() + Q31::max() == Q31::max());
+        assert(Q31::min() - Q31::max() == Q31::min());
+        assert(-Q31::min() == Q31::max());
+        assert(Q15::from_float(2.0f) == Q15::max());
+        assert(std::fabs((Q31::from_float(0.5f) * Q31::from_float(-0.25f)).to_float() + 0.125f) < 1e-9f);
+        assert(std::fabs((FixedGain{300.0f} * Q31::from_float(0.001f)).to_float() - 0.3f) < 1e-6f);
+        assert(FixedGain{300.0f} * Q31::from_float(0.5f) == Q31::max());
+        assert(std::fabs((FixedGain{-1e-6f} * Q31::from_float(0.5f)).to_float() + 5e-7f) < 1e-9f);
+    }
+
+} // namespace
+
+auto main() -> int {
+    test_float_matches_legacy();
+    test_derivative_matches_legacy();
+    test_input_wrapping();
+    run_fixed<Q31, PIDFQ31>(1e-5f, "Q31");
+    run_fixed<Q15, PIDFQ15>(2e-3f, "Q15");
+    test_no_derivative_kick();
+    test_derivative_filter();
+    test_back_calculation();
+    test_fixed_saturation();
+    std::cout << "all pidf tests passed\n";
+    return 0;
+}
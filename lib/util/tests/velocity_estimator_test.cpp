@@ -0,0 +1,227 @@
+#include "filtering.hpp"
+#include "velocity_estimator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace mrover;
+
+// Lag and noise of the encoder velocity estimators against the running mean QuadratureEncoder used to have.
+//
+// Without arguments the encoder is simulated: edges at the counts a known motion crosses, timestamped to the microsecond
+// like the 1 MHz elapsed timer does. Given a recording, one "time_us count" line per edge, it is replayed instead
+// and compared against a centered difference over the whole recording, which sees the future and so has no lag.
+
+namespace {
+
+    constexpr double TICK_S = 1e-6;
+    constexpr double UPDATE_HZ = 2000.0; // BMC control rate
+    constexpr std::size_t LEGACY_BUFFER_SIZE = 16;
+    constexpr float TRACKING_BANDWIDTH_HZ = 50.0f;
+    constexpr float EDGE_TIMEOUT_S = 0.5f;
+
+    using Reference = std::function<double(double)>; // counts/s at a time
+
+    struct Stats {
+        double rms{};  // counts/s
+        double bias{}; // counts/s, positive when the estimate trails
+    };
+
+    struct Evaluation {
+        Stats legacy, edge, tracking;
+    };
+
+    // encoder count at each update, and the last edge seen by then
+    auto evaluate(std::vector<EncoderEdge> const& edges, Reference const& reference, double const start_s, double const end_s, double const settle_s) -> Evaluation {
+        RunningMeanFilter<float, LEGACY_BUFFER_SIZE> legacy;
+        EdgeTimingEstimator edge{TICK_S, EDGE_TIMEOUT_S};
+        TrackingLoopEstimator tracking{TRACKING_BANDWIDTH_HZ};
+
+        double const dt = 1.0 / UPDATE_HZ;
+        std::size_t next = 0;
+        int32_t count = edges.empty() ? 0 : edges.front().count;
+        int32_t previous_count = count;
+        EncoderEdge latest{count, static_cast<uint32_t>(start_s / TICK_S)};
+
+        Evaluation result;
+        double sum_sq[3]{}, sum[3]{};
+        std::size_t n = 0;
+        for (double t = start_s; t < end_s; t += dt) {
+            auto const now_ticks = static_cast<uint32_t>(t / TICK_S);
+            while (next < edges.size() && edges[next].ticks <= now_ticks) {
+                latest = edges[next++];
+                count = latest.count;
+            }
+
+            legacy.add_reading(static_cast<float>(count - previous_count) / static_cast<float>(dt));
+            previous_count = count;
+            double const estimates[3]{
+                    legacy.get_filtered(),
+                    edge.update(latest, now_ticks),
+                    tracking.update(count, static_cast<float>(dt)),
+            };
+
+            if (t < start_s + settle_s) continue;
+            double const truth = reference(t);
+            for (int i = 0; i < 3; ++i) {
+                double const error = truth - estimates[i];
+                sum[i] += error;
+                sum_sq[i] += error * error;
+            }
+            ++n;
+        }
+        Stats* stats[3]{&result.legacy, &result.edge, &result.tracking};
+        for (int i = 0; i < 3; ++i) {
+            *stats[i] = {std::sqrt(sum_sq[i] / static_cast<double>(n)), sum[i] / static_cast<double>(n)};
+        }
+        return result;
+    }
+
+    // edges at every count crossed by a position, integrated finely from a velocity profile
+    auto simulate(Reference const& velocity, double const end_s) -> std::vector<EncoderEdge> {
+        std::vector<EncoderEdge> edges;
+        double position = 0.3; // start between counts
+        auto count = static_cast<int32_t>(std::floor(position));
+        for (uint32_t ticks = 0; ticks * TICK_S < end_s; ++ticks) {
+            position += velocity(ticks * TICK_S) * TICK_S;
+            if (auto const now = static_cast<int32_t>(std::floor(position)); now != count) {
+                count = now;
+                edges.push_back({count, ticks});
+            }
+        }
+        return edges;
+    }
+
+    auto report(char const* name, Evaluation const& e) -> void {
+        std::printf("%-28s rms/bias [counts/s]  running mean %9.2f %9.2f  edge timing %9.2f %9.2f  tracking loop %9.2f %9.2f\n", name,
+                    e.legacy.rms, e.legacy.bias, e.edge.rms, e.edge.bias, e.tracking.rms, e.tracking.bias);
+    }
+
+    auto test_constant_speed() -> void {
+        for (double const speed: {23.7, 237.0, 2370.0, 23700.0}) {
+            Reference const velocity = [=](double) { return speed; };
+            auto const edges = simulate(velocity, 2.0);
+            Evaluation const e = evaluate(edges, velocity, 0.0, 2.0, 0.5);
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "constant %.1f counts/s", speed);
+            report(name, e);
+
+            // edge periods are exact to a microsecond, so a few hundred microseconds between updates are good to a few tenths of a percent,
+            // while the mean is quantized to a count per window
+            assert(e.edge.rms < 2e-3 * speed + 1.0);
+            if (speed < UPDATE_HZ) {
+                assert(e.edge.rms < e.legacy.rms / 10.0);
+                assert(e.tracking.rms < e.legacy.rms);
+            }
+        }
+    }
+
+    auto test_ramp_lag() -> void {
+        constexpr double ACCELERATION = 5000.0; // counts/s^2
+        Reference const velocity = [](double const t) { return ACCELERATION * t; };
+        auto const edges = simulate(velocity, 2.0);
+        Evaluation const e = evaluate(edges, velocity, 0.0, 2.0, 0.5);
+        report("ramp 5000 counts/s^2", e);
+
+        double const legacy_lag = e.legacy.bias / ACCELERATION;
+        double const edge_lag = e.edge.bias / ACCELERATION;
+        double const tracking_lag = e.tracking.bias / ACCELERATION;
+        std::printf("%-28s lag [ms]             running mean %9.3f            edge timing %9.3f            tracking loop %9.3f\n", "",
+                    legacy_lag * 1e3, edge_lag * 1e3, tracking_lag * 1e3);
+
+        // the mean is centered half a window back, edge timing half an update period plus the edge spacing
+        double const window_s = LEGACY_BUFFER_SIZE / UPDATE_HZ;
+        assert(std::fabs(legacy_lag - window_s / 2.0) < 0.5e-3);
+        assert(edge_lag < legacy_lag / 4.0);
+        // a critically damped type 2 loop trails a ramp by 2 / omega
+        double const omega = 2.0 * detail::PI * TRACKING_BANDWIDTH_HZ;
+        assert(std::fabs(tracking_lag - 2.0 / omega) < 0.5e-3);
+    }
+
+    auto test_stop() -> void {
+        // coast down and stand still, the estimate has to get to zero without any edges saying so
+        Reference const velocity = [](double const t) { return t < 0.5 ? 100.0 : 0.0; };
+        auto const edges = simulate(velocity, 1.5);
+        Evaluation const e = evaluate(edges, velocity, 0.0, 1.5, 1.0);
+        report("stopped after 100 counts/s", e);
+        assert(e.legacy.rms == 0.0);
+        assert(e.edge.rms == 0.0);
+        assert(e.tracking.rms < 1.0);
+    }
+
+    auto test_timer_wrap() -> void {
+        // the 32-bit timestamp wraps every 71 minutes at 1 MHz
+        EdgeTimingEstimator edge{TICK_S, EDGE_TIMEOUT_S};
+        uint32_t const start = UINT32_MAX - 1500;
+        edge.update({0, start}, start);
+        float const velocity = edge.update({1, start + 2000}, start + 2500);
+        assert(std::fabs(velocity - 500.0f) < 1e-3f);
+    }
+
+    auto test_tracking_far_from_zero() -> void {
+        // counts far from zero must not cost the estimate its resolution
+        TrackingLoopEstimator tracking{TRACKING_BANDWIDTH_HZ};
+        int32_t count = 2'000'000'000;
+        double mean = 0.0;
+        for (int i = 0; i < 20000; ++i) {
+            if (i % 4 == 0) ++count;
+            float const velocity = tracking.update(count, 1.0f / static_cast<float>(UPDATE_HZ));
+            // it ripples with every count, the average has to be right
+            if (i >= 10000) mean += velocity / 10000.0;
+        }
+        assert(std::fabs(mean - UPDATE_HZ / 4.0) < 1.0);
+    }
+
+    // recorded edges, one "time_us count" per line
+    auto replay(char const* path) -> void {
+        std::ifstream file{path};
+        assert(file && "could not open the recording");
+        std::vector<EncoderEdge> edges;
+        std::vector<double> times;
+        uint32_t time_us;
+        int32_t count;
+        while (file >> time_us >> count) {
+            edges.push_back({count, time_us});
+            times.push_back(time_us * TICK_S);
+        }
+        assert(edges.size() > 2 && "the recording needs edges");
+
+        // position between edges by interpolation, differenced 10 ms either side
+        auto const position = [&](double const t) -> double {
+            auto const it = std::upper_bound(times.begin(), times.end(), t);
+            if (it == times.begin()) return edges.front().count;
+            if (it == times.end()) return edges.back().count;
+            std::size_t const i = it - times.begin();
+            double const f = (t - times[i - 1]) / (times[i] - times[i - 1]);
+            return edges[i - 1].count + f * (edges[i].count - edges[i - 1].count);
+        };
+        constexpr double HALF_WINDOW_S = 10e-3;
+        Reference const reference = [&](double const t) { return (position(t + HALF_WINDOW_S) - position(t - HALF_WINDOW_S)) / (2.0 * HALF_WINDOW_S); };
+
+        report(path, evaluate(edges, reference, times.front() + HALF_WINDOW_S, times.back() - HALF_WINDOW_S, 0.1));
+    }
+
+} // namespace
+
+auto main(int const argc, char** argv) -> int {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) replay(argv[i]);
+        return 0;
+    }
+
+    test_constant_speed();
+    test_ramp_lag();
+    test_stop();
+    test_timer_wrap();
+    test_tracking_far_from_zero();
+
+    std::cout << "velocity estimator tests passed" << std::endl;
+    return 0;
+}
@@ -56,7 +56,8 @@ void Error_Handler(void);
 void Init(void);
 void Loop(void);
 void Error(void);
-void Fault(void);
+void HardFault(uint32_t const* frame);
+void Tick(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -6,10 +6,12 @@
 #include <hw/as5047u.hpp>
 #include <hw/pin.hpp>
 #include <logger.hpp>
+#include <publish_policy.hpp>
 #include <serial/fdcan.hpp>
 #include <serial/spi.hpp>
 #include <serial/uart.hpp>
 #include <sys.hpp>
+#include <time_sync.hpp>
 #include <timer.hpp>
 
 #include "abs_config.hpp"
@@ -32,10 +34,34 @@ namespace mrover {
     static constexpr TIM_HandleTypeDef* ENCODER_TIM = &htim16; // default 30 Hz
     static constexpr TIM_HandleTypeDef* PUBLISH_TIM = &htim17; // default 30 Hz
 
+    static constexpr uint32_t HEALTH_PERIOD_MS = 1000;
+
+    // the crash record of the last reset is sent with this many health reports
+    static constexpr uint8_t CRASH_REPORT_COUNT = 5;
+
+    // warn when the stack comes this close to the heap
+    static constexpr uint32_t LOW_MEMORY_BYTES = 512;
+
+    // instrumented tasks, reported in ESWTaskDiagnostics
+    static constexpr uint8_t TASK_LOOP = 0;
+    static constexpr uint8_t TASK_ENCODER = 1;
+    static constexpr uint8_t TASK_TIMER_ISR = 2;
+    static constexpr uint8_t TASK_FDCAN_ISR = 3;
+    static constexpr uint8_t TASK_SPI_ISR = 4;
+    static constexpr uint8_t TASK_COUNT = 5;
+
     abs_config_t config;
     bool volatile initialized = false;
     bool volatile enc_request = false;
     bool volatile pending_pub = false;
+    uint32_t last_health_tick = 0;
+    uint8_t crash_reports_left = CRASH_REPORT_COUNT;
+    // frames following each health report, one per main loop pass so a burst never outruns the tx fifo
+    uint8_t diagnostics_step = TASK_COUNT + 1;
+    uint64_t encoder_sample_us = 0;
+
+    // host timebase for state message timestamps
+    TimeSync time_sync;
 
     // Peripherals
     std::optional<FDCAN> fdcan;
@@ -54,6 +80,9 @@ namespace mrover {
     std::optional<MRoverCANHandler> can_receiver;
     std::optional<AS5047U> encoder;
 
+    // position and velocity deadbands
+    PublishPolicy<2> publish_policy;
+
     auto init() -> void {
         System::InterruptGuard guard{};
         System::get().init(get_sys_options());
@@ -101,7 +130,17 @@ namespace mrover {
                 config.get<abs_config_t::min_bound>(),
                 config.get<abs_config_t::max_bound>());
 
+        // with a publish policy every encoder poll is a publish candidate and the publish timer is unused
+        publish_policy = PublishPolicy<2>{{
+                .deadbands = {config.get<abs_config_t::pub_pos_deadband>(), config.get<abs_config_t::pub_vel_deadband>()},
+                .heartbeat_ms = config.get<abs_config_t::pub_heartbeat_ms>(),
+                .min_interval_ms = config.get<abs_config_t::pub_min_interval_ms>(),
+        }};
+
         Logger::instance().info("Initialized ABS Encoder 0x%x", config.get<abs_config_t::can_id>());
+        if (auto const& crash = System::last_crash()) {
+            Logger::instance().warn("reset after fault %lu at pc 0x%08lx, cfsr 0x%08lx", crash->reason, crash->pc, crash->cfsr);
+        }
         initialized = true;
     }
 
@@ -122,6 +161,106 @@ namespace mrover {
         can_tx->reset();
     }
 
+    /**
+     * Publish the FDCAN error state and statistics.
+     */
+    auto send_health() -> void {
+        send_can_message(fdcan->health().to_message<ESWCANHealth>());
+    }
+
+    /**
+     * Report the fault that caused the last reset, if there was one.
+     */
+    auto send_crash_report() -> void {
+        auto const& crash = System::last_crash();
+        if (!crash) return;
+        send_can_message(ESWCrashReport{
+                static_cast<uint8_t>(crash->reason),
+                crash->pc,
+                crash->lr,
+                crash->psr,
+                crash->cfsr,
+                crash->hfsr,
+                crash->bfar,
+                crash->uptime_ms,
+                crash->can_id(0),
+                crash->can_id(1),
+                crash->can_id(2),
+                crash->can_id(3),
+                crash->can_id(4),
+                crash->can_id(5),
+                crash->can_id(6),
+                crash->can_id(7),
+        });
+    }
+
+    /**
+     * Publish stack and heap high-water marks and CPU load since the last report,
+     * and queue the per task timing and crash report behind them, see send_next_diagnostics.
+     */
+    auto send_diagnostics() -> void {
+        CpuLoad const load = Instrumentation::take_load();
+        System::MemoryUsage const memory = System::memory_usage();
+        send_can_message(ESWDiagnostics{
+                load.cpu_load(),
+                static_cast<uint16_t>(load.window_cycles / (SystemCoreClock / 1000U)),
+                load.max_isr_latency_cycles,
+                load.max_isr_cycles,
+                Instrumentation::ENABLED ? TASK_COUNT : uint8_t{0},
+                static_cast<uint16_t>(memory.stack_peak),
+                static_cast<uint16_t>(memory.stack_free),
+                static_cast<uint16_t>(memory.heap_used),
+                static_cast<uint16_t>(memory.heap_failures),
+                uint16_t{0}, // takes no commands
+        });
+        if (memory.stack_free < LOW_MEMORY_BYTES || memory.heap_failures != 0) {
+            Logger::instance().warn("low memory: stack peak %lu B, %lu B free, heap %lu B, %lu failed allocations",
+                                    memory.stack_peak, memory.stack_free, memory.heap_used, memory.heap_failures);
+        }
+        // without instrumentation there is no per task timing to follow
+        diagnostics_step = Instrumentation::ENABLED ? 0 : TASK_COUNT;
+    }
+
+    /**
+     * Send the next frame queued behind the last health report, if any.
+     */
+    auto send_next_diagnostics() -> void {
+        if (diagnostics_step < TASK_COUNT) {
+            uint8_t const task = diagnostics_step++;
+            TaskStats const stats = Instrumentation::take_task(task);
+            send_can_message(ESWTaskDiagnostics{
+                    task,
+                    stats.count,
+                    stats.min_cycles,
+                    stats.avg_cycles(),
+                    stats.max_cycles,
+                    stats.max_latency_cycles,
+                    stats.histogram[0],
+                    stats.histogram[1],
+                    stats.histogram[2],
+                    stats.histogram[3],
+                    stats.histogram[4],
+                    stats.histogram[5],
+                    stats.histogram[6],
+                    stats.histogram[7],
+                    stats.histogram[8],
+                    stats.histogram[9],
+                    stats.histogram[10],
+                    stats.histogram[11],
+                    stats.histogram[12],
+                    stats.histogram[13],
+                    stats.histogram[14],
+                    stats.histogram[15],
+            });
+        } else if (diagnostics_step == TASK_COUNT) {
+            ++diagnostics_step;
+            if (crash_reports_left > 0) {
+                send_crash_report();
+                --crash_reports_left;
+            }
+        }
+    }
+
     template<typename T>
     auto handle(T const& _) -> void {
     }
@@ -145,6 +284,26 @@ namespace mrover {
         }
     }
 
+    auto handle(ESWConfigBulkData const& msg) -> void {
+        send_can_message(config.handle_bulk(msg));
+    }
+
+    auto handle(ESWConfigBulkCommit const& msg) -> void {
+        ESWConfigBulkAck const ack = config.handle_bulk(msg);
+        send_can_message(ack);
+        if (msg.apply && ack.status == 0) {
+            Logger::instance().info("committed %u config registers", ack.count);
+        }
+    }
+
+    auto handle(ESWConfigBulkRead const& msg) -> void {
+        config.handle_bulk(msg, send_can_message);
+    }
+
+    auto handle(ESWTimeSyncFollowUp const& msg) -> void {
+        time_sync.on_follow_up(msg.sequence, msg.host_time);
+    }
+
     auto handle(ABSResetCmd const&) -> void {
         System::reset();
     }
@@ -164,9 +323,14 @@ namespace mrover {
         if (!initialized) return;
 
         while (fdcan->messages_to_process() > 0) {
-            if (auto const recv = can_receiver->receive(); recv) {
+            uint16_t rx_timestamp;
+            if (auto const recv = can_receiver->receive(FDCAN::RxFifo::Fifo0, &rx_timestamp); recv) {
                 can_rx->set();
                 auto const& msg = *recv;
+                // back-date the sync to when it hit the bus
+                if (auto const* sync = std::get_if<ESWTimeSync>(&msg)) {
+                    time_sync.on_sync(sync->sequence, System::get_micros64() - fdcan->timestamp_elapsed_ns(rx_timestamp) / 1000);
+                }
                 std::visit([](auto&& value) -> auto {
                     handle(value);
                 },
@@ -178,14 +342,40 @@ namespace mrover {
 
     [[noreturn]] auto loop() -> void {
         for (;;) {
+            uint32_t const loop_start = Instrumentation::now();
+            bool sampled = false;
             if (enc_request) {
+                Instrumentation::Scope const scope{TASK_ENCODER};
                 encoder->update();
+                encoder_sample_us = System::get_micros64();
                 enc_request = false;
+                sampled = true;
+            }
+            bool const due = publish_policy.enabled()
+                                     ? sampled && publish_policy.should_publish(System::get_ticks(), {encoder->get_position(), encoder->get_velocity()}, 0)
+                                     : pending_pub;
+            if (due) {
+                float const position = encoder->get_position();
+                float const velocity = encoder->get_velocity();
+                send_can_message(ABSEncoderState{position, velocity, time_sync.message_timestamp(encoder_sample_us)});
+                publish_policy.mark_published(System::get_ticks(), {position, velocity}, 0);
             }
-            if (pending_pub) {
-                send_can_message(ABSEncoderState{encoder->get_position(), encoder->get_velocity()});
-                pending_pub = false;
+            pending_pub = false;
+            // commit config changes between samples so the flash stall does not delay a poll
+            if (config.has_uncommitted() && !enc_request) {
+                uint64_t const start_us = System::get_micros64();
+                config.commit();
+                Logger::instance().info("config committed in %lu us", static_cast<uint32_t>(System::get_micros64() - start_us));
             }
+            fdcan->update_recovery();
+            if (uint32_t const now = System::get_ticks(); now - last_health_tick >= HEALTH_PERIOD_MS) {
+                send_health();
+                send_diagnostics();
+                last_health_tick = now;
+            } else {
+                send_next_diagnostics();
+            }
+            Instrumentation::record(TASK_LOOP, Instrumentation::now() - loop_start);
             System::dsb();
             System::get().wfi();
         }
@@ -233,15 +423,21 @@ void Error() {
     mrover::System::fault(mrover::System::fault_reason_t::HALT_ERROR);
 }
 
-void Fault(void) {
-    mrover::System::fault(mrover::System::fault_reason_t::HARD_FAULT);
+void HardFault(uint32_t const* frame) {
+    mrover::System::handle_hard_fault(frame);
+}
+
+void Tick() {
+    mrover::System::get_cycles64();
 }
 
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_TIMER_ISR, mrover::Instrumentation::timer_latency(htim), true};
     mrover::timer_elapsed_callback(htim);
 }
 
 void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_SPI_ISR, 0, true};
     mrover::spi_callback(hspi);
 }
 
@@ -250,6 +446,12 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
 }
 
 void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_FDCAN_ISR, 0, true};
+    mrover::fdcan->handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo0, RxFifo0ITs);
     mrover::receive_can_message();
 }
+
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+    mrover::fdcan->handle_error_status(ErrorStatusITs);
+}
 }
@@ -33,6 +33,12 @@ namespace mrover {
         // unrecoverable SPI error encountered
         SPI_ERROR_FATAL,
 
+        // encoder stopped reporting in position or velocity mode
+        ENCODER_LOST,
+
+        // autotuning reached a limit switch or left the position range
+        AUTOTUNE_OUT_OF_RANGE,
+
     };
 
 
@@ -57,6 +57,7 @@ void Error_Handler(void);
 /* USER CODE BEGIN EFP */
 void PostInit();
 void Loop();
+void Tick();
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
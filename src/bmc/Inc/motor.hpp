@@ -2,12 +2,19 @@
 
 #include <MRoverCAN.hpp>
 #include <algorithm>
+#include <array>
+#include <autotune.hpp>
 #include <cinttypes>
+#include <encoder_fusion.hpp>
 #include <hw/ad8418a.hpp>
 #include <hw/hbridge.hpp>
 #include <hw/limit_switch.hpp>
 #include <hw/quadrature.hpp>
 #include <pidf.hpp>
+#include <publish_policy.hpp>
+#include <seqlock.hpp>
+#include <sys.hpp>
+#include <trajectory.hpp>
 #include <variant>
 
 #include "bmc_config.hpp"
@@ -20,6 +27,20 @@ namespace mrover {
     class Motor {
         typedef void (*tx_exec_t)(MRoverCANMsg_t const& msg);
 
+        // accepted inner loop rates on the PWM timer interrupt
+        static constexpr float MIN_CONTROL_HZ = 1000.0f;
+        static constexpr float MAX_CONTROL_HZ = 10000.0f;
+
+        // delta_position is a stall threshold per 25 Hz control timer period
+        static constexpr float STALL_WINDOW_S = 0.04f;
+
+        // an ABS board silent for this long is gone, its readings usually come every 20 to 100 ms
+        static constexpr uint32_t ABS_TIMEOUT_US = 500'000;
+        static constexpr float DEFAULT_ABS_FUSE_HZ = 1.0f;
+
+        // a relay experiment that has not settled into a steady oscillation by now will not
+        static constexpr float AUTOTUNE_TIMEOUT_S = 30.0f;
+
         std::optional<HBridge> m_hbridge;
         std::optional<AD8418A> m_current_sensor;
         std::optional<LimitSwitch> m_limit_a;
@@ -28,9 +49,47 @@ namespace mrover {
 
         tx_exec_t m_message_tx_f{};
 
+        // position, velocity and current deadbands
+        PublishPolicy<3> m_publish_policy{};
+
         std::optional<PIDF> m_pidf{std::nullopt};
         ITimerChannel* m_pidf_elapsed_timer{};
 
+        // cascaded loops on the PWM timer interrupt: position every m_outer_div ticks into velocity every tick
+        std::optional<PIDF> m_inner_pidf{std::nullopt};
+        float m_inner_dt{}; // zero runs the single loop from the main loop instead
+        uint8_t m_outer_div{1};
+        uint8_t m_outer_count{};
+        float m_velocity_setpoint{};
+
+        // current loop on the same interrupt, fed by the sample taken in the middle of each PWM pulse
+        std::optional<PIDF> m_current_pidf{std::nullopt};
+        float m_max_current{};       // amps
+        float m_current_direction{}; // sense polarity relative to positive throttle
+
+        // position moves profiled on board, so one target gives a smooth move
+        Trajectory m_trajectory;
+        bool m_trajectory_en{false};
+        bool m_trajectory_restart{true}; // start the next profile from the measured state
+        float m_velocity_k_f{};          // throttle per unit velocity of the reference, single loop only
+        float m_acceleration_k_f{};      // throttle per unit acceleration of the reference
+        float m_acceleration_ff{};
+
+        // written by whichever context runs the loop, read by the state publisher
+        SeqLock<motor_telemetry_t> m_telemetry;
+
+        // absolute position from an ABS board, written by the CAN interrupt
+        SeqLock<abs_reading_t> m_abs_reading;
+        uint32_t m_abs_received{};
+        uint32_t m_abs_sequence{}; // last reading fused
+        EncoderFusion m_abs_fusion;
+
+        // relay experiment, run by whichever context runs the loop being tuned, reported from the main loop
+        RelayAutotune m_autotune;
+        SeqLock<autotune_report_t> m_autotune_report;
+        uint32_t m_autotune_finished{};
+        uint32_t m_autotune_reported{};
+
         std::optional<float> m_calibrated_offset{std::nullopt};     // revolutions
         std::optional<float> m_uncalibrated_position{std::nullopt}; // revolutions
         std::optional<float> m_velocity_raw{std::nullopt};          // revolutions/second
@@ -66,13 +125,50 @@ namespace mrover {
             m_target = 0.0f;
         }
 
+        [[nodiscard]] auto has_absolute() const -> bool {
+            return m_encoder_mode == encoder_mode_t::ABS || m_encoder_mode == encoder_mode_t::QUAD_ABS;
+        }
+
+        /**
+         * Bring in the latest ABS reading. On its own it is the position, extrapolated over its delay,
+         * with the quadrature encoder it calibrates it in place of the limit switches.
+         */
+        auto sample_absolute() -> void {
+            auto const now_us = static_cast<uint32_t>(System::get_micros64());
+            abs_reading_t const reading = m_abs_reading.read();
+            auto const age_us = std::max(static_cast<int32_t>(now_us - reading.sample_us), int32_t{0});
+            bool const alive = reading.sequence != 0 && static_cast<uint32_t>(age_us) < ABS_TIMEOUT_US;
+
+            if (m_encoder_mode == encoder_mode_t::ABS) {
+                if (!alive) return;
+                float const age_s = static_cast<float>(age_us) * 1e-6f;
+                m_uncalibrated_position = (reading.position + reading.velocity * age_s) / m_rotor_output_ratio;
+                m_velocity_raw = reading.velocity / m_rotor_output_ratio;
+                m_calibrated_offset = 0.0f;
+                return;
+            }
+
+            if (!m_uncalibrated_position) return;
+            m_abs_fusion.record(now_us, *m_uncalibrated_position);
+            if (reading.sequence == m_abs_sequence) return;
+            m_abs_sequence = reading.sequence;
+
+            bool const was_locked = m_abs_fusion.locked();
+            if (!m_abs_fusion.correct(reading.sample_us, reading.position / m_rotor_output_ratio)) return;
+            // the measured position appeared, so should the reference
+            if (!was_locked) m_trajectory_restart = true;
+            m_calibrated_offset = -m_abs_fusion.offset();
+        }
+
         auto sample_encoder() -> void {
             switch (m_encoder_mode) {
                 case encoder_mode_t::NONE:
+                case encoder_mode_t::ABS:
                     m_uncalibrated_position.reset();
                     m_velocity_raw.reset();
                     break;
                 case encoder_mode_t::QUAD:
+                case encoder_mode_t::QUAD_ABS:
                     m_quad_encoder->update();
                     if (std::optional<EncoderReading> reading = m_quad_encoder->read()) {
                         auto const& [position, velocity] = reading.value();
@@ -84,6 +180,7 @@ namespace mrover {
                     }
                     break;
             }
+            if (has_absolute()) sample_absolute();
 
             m_position = [this] -> float {
                 if (m_uncalibrated_position && m_calibrated_offset) return (m_uncalibrated_position.value() - m_calibrated_offset.value()) * m_rotor_output_ratio;
@@ -94,6 +191,14 @@ namespace mrover {
                 if (m_velocity_raw) return m_velocity_raw.value() * m_rotor_output_ratio;
                 return std::numeric_limits<float>::quiet_NaN();
             }();
+
+            // the feedback went away under a closed loop
+            bool const position_loop = m_mode == mode_t::POSITION || m_mode == mode_t::AUTOTUNE_POSITION;
+            bool const velocity_loop = m_mode == mode_t::VELOCITY || m_mode == mode_t::AUTOTUNE_VELOCITY;
+            if ((position_loop && std::isnan(m_position)) || (velocity_loop && std::isnan(m_velocity))) {
+                m_mode = mode_t::FAULT;
+                m_error = bmc_error_t::ENCODER_LOST;
+            }
         }
 
         auto apply_limit(std::optional<LimitSwitch>& limit, bool& at_limit, bool& forward_hit, bool& backward_hit) -> void {
@@ -113,17 +218,24 @@ namespace mrover {
             forward_hit = limit->active() && limit->limits_forward();
             backward_hit = limit->active() && !limit->limits_forward();
 
-            // readjust
-            if (at_limit) {
+            // readjust, unless an absolute encoder calibrates the position
+            if (at_limit && !has_absolute()) {
                 if (auto const readjustment_position = limit->get_readjustment_position(); readjustment_position && m_uncalibrated_position) {
-                    m_calibrated_offset = *m_uncalibrated_position - *readjustment_position;
+                    float const offset = *m_uncalibrated_position - *readjustment_position;
+                    // the measured position jumped, so should the reference
+                    if (offset != m_calibrated_offset) m_trajectory_restart = true;
+                    m_calibrated_offset = offset;
                 }
             }
         }
 
         auto detect_stall() -> void {
             if (m_stall_en && m_current_sensor && m_current_sensor->current() > m_stall_current) {
-                if (m_quad_encoder) {
+                if (m_quad_encoder && control_in_isr()) {
+                    // the encoder delta is per inner loop tick, compare the motion over a control timer period instead
+                    float const velocity_raw = m_telemetry.read().velocity / m_rotor_output_ratio;
+                    m_stalled = velocity_raw * STALL_WINDOW_S < m_delta_position;
+                } else if (m_quad_encoder) {
                     m_stalled = m_quad_encoder->get_delta_position() < m_delta_position;
                 } else {
                     m_stalled = true;
@@ -134,31 +246,159 @@ namespace mrover {
             }
         }
 
+        [[nodiscard]] auto state_values(motor_telemetry_t const& telemetry) const -> std::array<float, 3> {
+            return {telemetry.position, telemetry.velocity, m_current_sensor ? m_current_sensor->current() : std::numeric_limits<float>::quiet_NaN()};
+        }
+
+        // transitions that are published immediately instead of waiting for a deadband or heartbeat
+        [[nodiscard]] auto state_events(motor_telemetry_t const& telemetry) const -> uint32_t {
+            return static_cast<uint32_t>(m_mode) |
+                   static_cast<uint32_t>(m_error) << 8 |
+                   static_cast<uint32_t>(telemetry.limit_a_hit) << 16 |
+                   static_cast<uint32_t>(telemetry.limit_b_hit) << 17 |
+                   static_cast<uint32_t>(m_stalled) << 18;
+        }
+
+        auto publish_telemetry() -> void {
+            m_telemetry.write({
+                    .position = m_position,
+                    .velocity = m_velocity,
+                    .limit_a_hit = m_limit_a_hit,
+                    .limit_b_hit = m_limit_b_hit,
+            });
+        }
+
+        // never drive further into an active limit switch
+        [[nodiscard]] auto limit_output(float const throttle) const -> float {
+            if (throttle > 0.0f && m_limit_forward_hit) return 0.0f;
+            if (throttle < 0.0f && m_limit_backward_hit) return 0.0f;
+            return throttle;
+        }
+
+        /**
+         * Position reference for this step, the target itself without a trajectory configured.
+         * Called only from the context running the position loop.
+         * @param dt seconds since the last call
+         */
+        MROVER_RAMFUNC auto position_reference(float const target_pos, float const dt) -> Trajectory::Setpoint {
+            if (!m_trajectory_en) return {target_pos, 0.0f, 0.0f};
+            if (m_trajectory_restart) {
+                m_trajectory_restart = false;
+                m_trajectory.plan(m_position, std::isnan(m_velocity) ? 0.0f : m_velocity, target_pos);
+            } else {
+                m_trajectory.set_goal(target_pos);
+            }
+            return m_trajectory.step(dt);
+        }
+
+        [[nodiscard]] auto autotuning() const -> bool {
+            return m_mode == mode_t::AUTOTUNE_POSITION || m_mode == mode_t::AUTOTUNE_VELOCITY;
+        }
+
+        /**
+         * (Re)start the relay experiment around the target. A velocity relay starts around the throttle
+         * the feedforward expects to hold the target, the experiment moves it to the one that does.
+         */
+        auto start_autotune() -> void {
+            float const hysteresis = m_config_ptr->get<bmc_config_t::tune_hyst>();
+            m_autotune = RelayAutotune{{
+                    .amplitude = m_config_ptr->get<bmc_config_t::tune_relay>(),
+                    .hysteresis = hysteresis > 0.0f ? hysteresis : 0.0f,
+                    .timeout_s = AUTOTUNE_TIMEOUT_S,
+            }};
+            float const centre = m_mode == mode_t::AUTOTUNE_VELOCITY && std::isfinite(m_velocity_k_f) ? m_velocity_k_f * m_target : 0.0f;
+            m_autotune.start(m_target, centre);
+        }
+
+        /**
+         * One step of the relay experiment, which ends it once it is over or the joint is no longer safe to swing.
+         * Called only from the context running the loop being tuned.
+         * @return output of the loop being tuned
+         */
+        MROVER_RAMFUNC auto autotune_step(float const input, float const dt) -> float {
+            // the relay drives both ways, so any limit switch ends it, as does leaving a configured position range
+            bool const out_of_range = m_min_position < m_max_position && (m_position < m_min_position || m_position > m_max_position);
+            if (m_limit_forward_hit || m_limit_backward_hit || out_of_range) m_autotune.abort();
+            float const output = m_autotune.step(input, dt);
+            if (m_autotune.status() != RelayAutotune::Status::RUNNING) finish_autotune();
+            return output;
+        }
+
+        auto finish_autotune() -> void {
+            m_autotune_report.write({
+                    .mode = m_mode,
+                    .status = m_autotune.status(),
+                    .result = m_autotune.result(),
+                    .sequence = ++m_autotune_finished,
+            });
+            if (m_autotune.status() == RelayAutotune::Status::ABORTED) {
+                m_mode = mode_t::FAULT;
+                m_error = bmc_error_t::AUTOTUNE_OUT_OF_RANGE;
+            } else {
+                m_mode = mode_t::STOPPED;
+            }
+            m_target = 0.0f;
+        }
+
+        auto load_gains() -> void {
+            // the outer position loop commands a velocity when the loops are cascaded, a throttle otherwise
+            if (m_mode == mode_t::POSITION) {
+                m_pidf->with_p(m_config_ptr->get<bmc_config_t::pos_k_p>());
+                m_pidf->with_i(m_config_ptr->get<bmc_config_t::pos_k_i>());
+                m_pidf->with_d(m_config_ptr->get<bmc_config_t::pos_k_d>());
+                m_pidf->with_ff(m_config_ptr->get<bmc_config_t::pos_k_f>());
+                if (control_in_isr()) {
+                    m_pidf->with_output_bound(m_min_velocity, m_max_velocity);
+                } else {
+                    m_pidf->with_output_bound(-1.0, 1.0);
+                }
+            }
+            if (m_mode == mode_t::VELOCITY) {
+                m_pidf->with_p(m_config_ptr->get<bmc_config_t::vel_k_p>());
+                m_pidf->with_i(m_config_ptr->get<bmc_config_t::vel_k_i>());
+                m_pidf->with_d(m_config_ptr->get<bmc_config_t::vel_k_d>());
+                m_pidf->with_ff(m_config_ptr->get<bmc_config_t::vel_k_f>());
+                m_pidf->with_output_bound(-1.0, 1.0);
+            }
+            if (m_mode == mode_t::CURRENT) {
+                m_current_pidf = PIDF{};
+                m_current_pidf->with_p(m_config_ptr->get<bmc_config_t::cur_k_p>());
+                m_current_pidf->with_i(m_config_ptr->get<bmc_config_t::cur_k_i>());
+                m_current_pidf->with_d(m_config_ptr->get<bmc_config_t::cur_k_d>());
+                m_current_pidf->with_ff(m_config_ptr->get<bmc_config_t::cur_k_f>());
+                m_current_pidf->with_output_bound(-1.0, 1.0);
+            }
+            // fresh integrator for the inner velocity loop on every mode change
+            m_inner_pidf = PIDF{};
+            m_inner_pidf->with_p(m_config_ptr->get<bmc_config_t::vel_k_p>());
+            m_inner_pidf->with_i(m_config_ptr->get<bmc_config_t::vel_k_i>());
+            m_inner_pidf->with_d(m_config_ptr->get<bmc_config_t::vel_k_d>());
+            m_inner_pidf->with_ff(m_config_ptr->get<bmc_config_t::vel_k_f>());
+            m_inner_pidf->with_output_bound(-1.0, 1.0);
+            m_velocity_setpoint = 0.0f;
+            m_acceleration_ff = 0.0f;
+            m_outer_count = 0;
+            m_trajectory_restart = true;
+        }
+
         auto write_output_pwm() -> void {
             if (m_enabled) {
                 switch (m_mode) {
                     case mode_t::STOPPED:
                     case mode_t::FAULT:
+                    case mode_t::CURRENT: // only accepted with the loops on the control interrupt
                         if (m_hbridge->is_on()) m_hbridge->stop();
                         break;
                     case mode_t::THROTTLE:
                         if (!m_hbridge->is_on()) m_hbridge->start();
-                        {
-                            auto setpoint_thr = m_target; // input is throttle
-                            if (setpoint_thr > 0.0f && m_limit_forward_hit) setpoint_thr = 0.0f;
-                            if (setpoint_thr < 0.0f && m_limit_backward_hit) setpoint_thr = 0.0f;
-                            m_hbridge->write(setpoint_thr);
-                        }
+                        m_hbridge->write(limit_output(m_target)); // input is throttle
                         break;
                     case mode_t::VELOCITY:
                         if (!m_hbridge->is_on()) m_hbridge->start();
                         {
                             auto const target_vel = std::clamp(m_target, m_min_velocity, m_max_velocity); // unit of output
                             auto const input_vel = m_velocity_raw.value() * m_rotor_output_ratio;         // revolutions/sec * output scalar
-                            auto setpoint_thr = m_pidf->calculate(input_vel, target_vel, m_pidf_elapsed_timer->get_dt());
-                            if (setpoint_thr > 0.0f && m_limit_forward_hit) setpoint_thr = 0.0f;
-                            if (setpoint_thr < 0.0f && m_limit_backward_hit) setpoint_thr = 0.0f;
-                            m_hbridge->write(setpoint_thr);
+                            m_hbridge->write(limit_output(m_pidf->calculate(input_vel, target_vel, m_pidf_elapsed_timer->get_dt())));
                         }
                         break;
                     case mode_t::POSITION:
@@ -166,10 +406,18 @@ namespace mrover {
                         {
                             auto const target_pos = std::clamp(m_target, m_min_position, m_max_position);                                  // unit of output
                             auto const input_pos = (m_uncalibrated_position.value() - m_calibrated_offset.value()) * m_rotor_output_ratio; // revolutions * output scalar
-                            auto setpoint_thr = m_pidf->calculate(input_pos, target_pos, m_pidf_elapsed_timer->get_dt());
-                            if (setpoint_thr > 0.0f && m_limit_forward_hit) setpoint_thr = 0.0f;
-                            if (setpoint_thr < 0.0f && m_limit_backward_hit) setpoint_thr = 0.0f;
-                            m_hbridge->write(setpoint_thr);
+                            auto const dt = m_pidf_elapsed_timer->get_dt();
+                            auto const [ref_pos, ref_vel, ref_acc] = position_reference(target_pos, dt);
+                            auto const feedforward = m_velocity_k_f * ref_vel + m_acceleration_k_f * ref_acc;
+                            m_hbridge->write(limit_output(std::clamp(m_pidf->calculate(input_pos, ref_pos, dt) + feedforward, -1.0f, 1.0f)));
+                        }
+                        break;
+                    case mode_t::AUTOTUNE_POSITION:
+                    case mode_t::AUTOTUNE_VELOCITY:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        {
+                            auto const input = m_mode == mode_t::AUTOTUNE_POSITION ? m_position : m_velocity;
+                            m_hbridge->write(limit_output(std::clamp(autotune_step(input, m_pidf_elapsed_timer->get_dt()), -1.0f, 1.0f)));
                         }
                         break;
                 }
@@ -189,19 +437,48 @@ namespace mrover {
             m_hbridge->set_inverted(m_config_ptr->get<bmc_config_t::motor_inv>());
             m_hbridge->set_max_pwm(m_config_ptr->get<bmc_config_t::max_pwm>());
 
-            // configure current sensor
-            m_current_sensor->init(get_current_sensor_options());
-
-            // read pidf gains
-            m_pidf = PIDF{};
-            m_pidf->with_output_bound(-1.0, 1.0);
-
             // get velocity clamps
             m_min_position = m_config_ptr->get<bmc_config_t::min_pos>();
             m_max_position = m_config_ptr->get<bmc_config_t::max_pos>();
             m_min_velocity = m_config_ptr->get<bmc_config_t::min_vel>();
             m_max_velocity = m_config_ptr->get<bmc_config_t::max_vel>();
 
+            // inner loop on the PWM timer interrupt, 0 (or erased flash) keeps the single loop on the control timer
+            if (uint16_t const control_hz = m_config_ptr->get<bmc_config_t::control_hz>(); control_hz != 0 && control_hz != 0xFFFF) {
+                float const target_hz = std::clamp(static_cast<float>(control_hz), MIN_CONTROL_HZ, MAX_CONTROL_HZ);
+                auto const periods = static_cast<uint32_t>(std::max(std::round(m_hbridge->pwm_frequency() / target_hz), 1.0f));
+                m_inner_dt = 1.0f / m_hbridge->enable_update_interrupt(periods);
+            } else {
+                m_hbridge->disable_update_interrupt();
+                m_inner_dt = 0.0f;
+            }
+            uint8_t const outer_div = m_config_ptr->get<bmc_config_t::outer_loop_div>();
+            m_outer_div = outer_div == 0 || outer_div == 0xFF ? 1 : outer_div;
+
+            // position trajectory, off unless both velocity and acceleration limits are set, no jerk limit makes it trapezoidal
+            m_trajectory.set_limits({
+                    .max_velocity = m_config_ptr->get<bmc_config_t::traj_max_vel>(),
+                    .max_acceleration = m_config_ptr->get<bmc_config_t::traj_max_acc>(),
+                    .max_jerk = m_config_ptr->get<bmc_config_t::traj_max_jerk>(),
+            });
+            m_trajectory_en = m_trajectory.valid();
+            m_trajectory_restart = true;
+            m_velocity_k_f = m_config_ptr->get<bmc_config_t::vel_k_f>();
+            m_acceleration_k_f = m_trajectory_en ? m_config_ptr->get<bmc_config_t::traj_k_a>() : 0.0f;
+            if (std::isnan(m_acceleration_k_f)) m_acceleration_k_f = 0.0f;
+
+            // configure current sensor, sampled in the middle of each PWM pulse when a current loop can use it
+            AD8418A::Options current_sensor_options = get_current_sensor_options();
+            if (!control_in_isr()) current_sensor_options.sample_trigger.reset();
+            m_current_sensor->init(current_sensor_options);
+            m_max_current = m_config_ptr->get<bmc_config_t::max_cur>();
+            // reversing the bridge reverses the current through the shunt
+            m_current_direction = m_config_ptr->get<bmc_config_t::motor_inv>() ? -1.0f : 1.0f;
+
+            // read pidf gains
+            m_pidf = PIDF{};
+            load_gains();
+
             // init limit switches
             bool present = m_config_ptr->get<bmc_config_t::lim_a_present>();
             bool en = m_config_ptr->get<bmc_config_t::lim_a_en>();
@@ -221,6 +498,9 @@ namespace mrover {
 
             // initialize encoders (error if multiple enabled)
             bool const quad = m_config_ptr->get<bmc_config_t::quad_en>();
+            uint8_t const abs_can_id = m_config_ptr->get<bmc_config_t::abs_can_id>();
+            bool const abs = abs_can_id != 0 && abs_can_id != 0xFF;
+            encoder_mode_t const previous_encoder_mode = m_encoder_mode;
             m_rotor_output_ratio = m_config_ptr->get<bmc_config_t::rotor_output_ratio>();
 
             // initialize stall detection values
@@ -228,15 +508,36 @@ namespace mrover {
             m_stall_current = m_config_ptr->get<bmc_config_t::stall_current>();
             m_delta_position = m_config_ptr->get<bmc_config_t::delta_position>();
 
+            // state publishing policy
+            m_publish_policy = PublishPolicy<3>{{
+                    .deadbands = {
+                            m_config_ptr->get<bmc_config_t::pub_pos_deadband>(),
+                            m_config_ptr->get<bmc_config_t::pub_vel_deadband>(),
+                            m_config_ptr->get<bmc_config_t::pub_cur_deadband>(),
+                    },
+                    .heartbeat_ms = m_config_ptr->get<bmc_config_t::pub_heartbeat_ms>(),
+                    .min_interval_ms = m_config_ptr->get<bmc_config_t::pub_min_interval_ms>(),
+            }};
+
             if (quad) {
                 m_encoder_mode = encoder_mode_t::QUAD;
                 float const phase = m_config_ptr->get<bmc_config_t::quad_phase>() ? 1.0f : -1.0f;
                 float const gear_ratio = m_config_ptr->get<bmc_config_t::gear_ratio>();
                 float const cpr = m_config_ptr->get<bmc_config_t::quad_cpr>();
-                m_quad_encoder->init(phase / gear_ratio, cpr);
+                // 0 (or erased flash) keeps the running mean
+                uint8_t const estimator = m_config_ptr->get<bmc_config_t::quad_vel_est>();
+                m_quad_encoder->init(phase / gear_ratio, cpr,
+                                     estimator <= static_cast<uint8_t>(VelocityEstimator::TRACKING_LOOP) ? static_cast<VelocityEstimator>(estimator) : VelocityEstimator::RUNNING_MEAN,
+                                     m_config_ptr->get<bmc_config_t::quad_vel_bw>());
+                if (abs) m_encoder_mode = encoder_mode_t::QUAD_ABS;
             } else {
-                m_encoder_mode = encoder_mode_t::NONE;
+                m_encoder_mode = abs ? encoder_mode_t::ABS : encoder_mode_t::NONE;
             }
+
+            // the ABS board is trusted below the crossover, the quadrature encoder above it
+            float const fuse_hz = m_config_ptr->get<bmc_config_t::abs_fuse_hz>();
+            m_abs_fusion.set_crossover(fuse_hz > 0.0f ? fuse_hz : DEFAULT_ABS_FUSE_HZ);
+            if (m_encoder_mode != previous_encoder_mode) m_abs_fusion.reset();
         }
 
         template<typename T>
@@ -249,32 +550,39 @@ namespace mrover {
         }
 
         auto handle(BMCModeCmd const& msg) -> void {
+            mode_t const previous_mode = m_mode;
             // stop if not enabled, consume mode only if enabled
             if (!msg.enable)
                 m_mode = mode_t::STOPPED;
             else {
                 m_mode = static_cast<mode_t>(msg.mode);
-                if ((m_mode == mode_t::POSITION || m_mode == mode_t::VELOCITY) && m_encoder_mode == encoder_mode_t::NONE) {
+                if ((m_mode == mode_t::POSITION || m_mode == mode_t::VELOCITY || autotuning()) && m_encoder_mode == encoder_mode_t::NONE) {
                     m_mode = mode_t::FAULT;
                     m_error = bmc_error_t::INVALID_CONFIGURATION_FOR_MODE;
                 }
-                if (m_mode == mode_t::POSITION) {
+                if (m_mode == mode_t::POSITION || m_mode == mode_t::AUTOTUNE_POSITION) {
                     if (std::isnan(m_position)) {
                         m_mode = mode_t::FAULT;
                         m_error = bmc_error_t::INVALID_CONFIGURATION_FOR_MODE;
                     }
                 }
-                if (m_mode == mode_t::POSITION) {
-                    m_pidf->with_p(m_config_ptr->get<bmc_config_t::pos_k_p>());
-                    m_pidf->with_i(m_config_ptr->get<bmc_config_t::pos_k_i>());
-                    m_pidf->with_d(m_config_ptr->get<bmc_config_t::pos_k_d>());
-                    m_pidf->with_ff(m_config_ptr->get<bmc_config_t::pos_k_f>());
+                // the current loop needs the control interrupt and a measured sense offset
+                if (m_mode == mode_t::CURRENT && (!control_in_isr() || !m_current_sensor->calibrated())) {
+                    m_mode = mode_t::FAULT;
+                    m_error = bmc_error_t::INVALID_CONFIGURATION_FOR_MODE;
+                }
+                // a relay of no amplitude (or erased flash) has nothing to measure
+                if (autotuning() && !(m_config_ptr->get<bmc_config_t::tune_relay>() > 0.0f)) {
+                    m_mode = mode_t::FAULT;
+                    m_error = bmc_error_t::INVALID_CONFIGURATION_FOR_MODE;
                 }
-                if (m_mode == mode_t::VELOCITY) {
-                    m_pidf->with_p(m_config_ptr->get<bmc_config_t::vel_k_p>());
-                    m_pidf->with_i(m_config_ptr->get<bmc_config_t::vel_k_i>());
-                    m_pidf->with_d(m_config_ptr->get<bmc_config_t::vel_k_d>());
-                    m_pidf->with_ff(m_config_ptr->get<bmc_config_t::vel_k_f>());
+                // the control interrupt shares this priority, so it cannot run between the mode and its gains
+                load_gains();
+                // position is tuned where the joint is until told otherwise, velocity around standing still,
+                // and a repeat of the command leaves the experiment running
+                if (autotuning() && m_mode != previous_mode) {
+                    m_target = m_mode == mode_t::AUTOTUNE_POSITION ? m_position : 0.0f;
+                    start_autotune();
                 }
             }
             m_pidf_elapsed_timer->forget_reads();
@@ -292,14 +600,59 @@ namespace mrover {
                 case mode_t::THROTTLE:
                 case mode_t::POSITION:
                 case mode_t::VELOCITY:
+                case mode_t::CURRENT:
                     m_target = msg.target;
                     break;
+                // a new target starts the experiment over, repeats of the same one leave it running
+                case mode_t::AUTOTUNE_POSITION:
+                case mode_t::AUTOTUNE_VELOCITY:
+                    if (float const target = m_mode == mode_t::AUTOTUNE_POSITION ? std::clamp(msg.target, m_min_position, m_max_position)
+                                                                                 : std::clamp(msg.target, m_min_velocity, m_max_velocity);
+                        target != m_target) {
+                        m_target = target;
+                        start_autotune();
+                    }
+                    break;
             }
         }
 
+        auto handle(BMCGroupTargetCmd const& msg) -> void {
+            // 0 opts out, 0xFF is erased flash on a board configured before the register existed
+            uint8_t const group_id = m_config_ptr->get<bmc_config_t::group_id>();
+            if (group_id == 0 || group_id == 0xFF) return;
+
+            // every member of the group receives the same frame, so applying on reception lines the joints up
+            uint8_t const can_id = m_config_ptr->get<bmc_config_t::can_id>();
+            std::array const slots{
+                    std::pair{msg.node_id_0, msg.target_0},
+                    std::pair{msg.node_id_1, msg.target_1},
+                    std::pair{msg.node_id_2, msg.target_2},
+                    std::pair{msg.node_id_3, msg.target_3},
+                    std::pair{msg.node_id_4, msg.target_4},
+                    std::pair{msg.node_id_5, msg.target_5},
+                    std::pair{msg.node_id_6, msg.target_6},
+                    std::pair{msg.node_id_7, msg.target_7},
+                    std::pair{msg.node_id_8, msg.target_8},
+                    std::pair{msg.node_id_9, msg.target_9},
+                    std::pair{msg.node_id_10, msg.target_10},
+                    std::pair{msg.node_id_11, msg.target_11},
+            };
+            for (std::size_t i = 0; i < slots.size(); ++i) {
+                auto const& [node_id, target] = slots[i];
+                if (!(msg.valid_mask & (1 << i)) || node_id != can_id) continue;
+                handle(BMCTargetCmd{target, true});
+                return;
+            }
+        }
+
+        // The config handlers run from fifo0, which the target handlers on fifo1 preempt. Those read registers,
+        // so anything that changes the store or invalidates the cache runs with interrupts masked, together with
+        // the re-init that follows. Reads and bulk staging (a batch only fifo0 uses) leave the store as it is.
+
         auto handle(ESWConfigCmd const& msg) -> void {
             // input can either be a request to set a value (apply is set) or read a value (apply not set)
             if (msg.apply) {
+                System::InterruptGuard guard{};
                 if (m_config_ptr->set_raw(msg.address, msg.value)) {
                     // re-initialize after configuration is modified
                     init();
@@ -312,6 +665,27 @@ namespace mrover {
             }
         }
 
+        auto handle(ESWConfigBulkData const& msg) -> void {
+            m_message_tx_f(m_config_ptr->handle_bulk(msg));
+        }
+
+        auto handle(ESWConfigBulkCommit const& msg) -> void {
+            ESWConfigBulkAck const ack = [&] -> ESWConfigBulkAck {
+                System::InterruptGuard guard{};
+                ESWConfigBulkAck const result = m_config_ptr->handle_bulk(msg);
+                if (msg.apply && result.status == 0) {
+                    // re-initialize after configuration is modified
+                    init();
+                }
+                return result;
+            }();
+            m_message_tx_f(ack);
+        }
+
+        auto handle(ESWConfigBulkRead const& msg) const -> void {
+            m_config_ptr->handle_bulk(msg, m_message_tx_f);
+        }
+
         auto handle(BMCResetCmd const& msg) -> void {
             reset();
         }
@@ -346,36 +720,217 @@ namespace mrover {
                        v);
         }
 
-        auto send_state() -> void {
-            auto const current = [this]() -> float {
-                if (m_current_sensor) {
-                    m_current_sensor->update_sensor();
-                    detect_stall();
-                    return m_current_sensor->current();
-                }
-                return std::numeric_limits<float>::quiet_NaN();
-            }();
+        /**
+         * Latest state of the ABS board this one is configured to follow.
+         * @param sample_us local time it was sampled at, see System::get_micros64
+         */
+        auto receive_absolute(ABSEncoderState const& msg, uint32_t const sample_us) -> void {
+            if (!has_absolute()) return;
+            m_abs_reading.write({
+                    .position = msg.position,
+                    .velocity = msg.velocity,
+                    .sample_us = sample_us,
+                    .sequence = ++m_abs_received,
+            });
+        }
+
+        /**
+         * @param timestamp host-synchronized sample time in microseconds, zero if unsynchronized
+         */
+        auto send_state(uint32_t const timestamp = 0) -> void {
+            motor_telemetry_t const telemetry = m_telemetry.read();
+            auto const [position, velocity, current] = state_values(telemetry);
 
             m_message_tx_f(BMCMotorState{
                     static_cast<uint8_t>(m_mode),  // mode
                     static_cast<uint8_t>(m_error), // fault-code
-                    m_position,                    // position
-                    m_velocity,                    // velocity
+                    position,                      // position
+                    velocity,                      // velocity
                     current,                       // current
-                    m_limit_a_hit,                 // limit_a_set
-                    m_limit_b_hit,                 // limit_b_set
+                    timestamp,                     // timestamp
+                    telemetry.limit_a_hit,         // limit_a_set
+                    telemetry.limit_b_hit,         // limit_b_set
                     m_stalled                      // is_stalled
             });
+            m_publish_policy.mark_published(System::get_ticks(), {position, velocity, current}, state_events(telemetry));
+        }
+
+        /**
+         * Report a finished relay experiment, and with tune_commit set write the gains it found into the configuration,
+         * which the main loop commits to flash once the output is idle. Call from the main loop.
+         */
+        auto report_autotune() -> void {
+            autotune_report_t const report = m_autotune_report.read();
+            if (report.sequence == m_autotune_reported) return;
+            m_autotune_reported = report.sequence;
+
+            bool const done = report.status == RelayAutotune::Status::DONE;
+            // anything unknown, erased flash included, falls back to Ziegler-Nichols
+            uint8_t const rule = m_config_ptr->get<bmc_config_t::tune_rule>();
+            TuningRule const tuning_rule = rule <= static_cast<uint8_t>(TuningRule::TYREUS_LUYBEN_PI) ? static_cast<TuningRule>(rule) : TuningRule::ZIEGLER_NICHOLS;
+            PIDGains const gains = done ? tune_gains(report.result, tuning_rule) : PIDGains{};
+            bool const commit = done && m_config_ptr->get<bmc_config_t::tune_commit>() == 1;
+            if (commit) {
+                if (report.mode == mode_t::AUTOTUNE_POSITION) {
+                    m_config_ptr->set<bmc_config_t::pos_k_p>(gains.p);
+                    m_config_ptr->set<bmc_config_t::pos_k_i>(gains.i);
+                    m_config_ptr->set<bmc_config_t::pos_k_d>(gains.d);
+                } else {
+                    m_config_ptr->set<bmc_config_t::vel_k_p>(gains.p);
+                    m_config_ptr->set<bmc_config_t::vel_k_i>(gains.i);
+                    m_config_ptr->set<bmc_config_t::vel_k_d>(gains.d);
+                }
+                // re-initialize after configuration is modified
+                init();
+            }
+
+            m_message_tx_f(BMCAutotuneResult{
+                    static_cast<uint8_t>(report.status), // status
+                    static_cast<uint8_t>(report.mode),   // mode
+                    report.result.ultimate_gain,         // ultimate_gain
+                    report.result.ultimate_period,       // ultimate_period
+                    gains.p,                             // k_p
+                    gains.i,                             // k_i
+                    gains.d,                             // k_d
+                    commit                               // committed
+            });
+        }
+
+        /**
+         * Sample the current sensor and stall state, called on every transmit timer tick.
+         */
+        auto sample_state() -> void {
+            if (m_current_sensor) {
+                m_current_sensor->update_sensor();
+                detect_stall();
+            }
+        }
+
+        /**
+         * Whether the state should go out now.
+         * Without a publish policy configured the state goes out on every transmit timer tick.
+         * @param tick true if the transmit timer elapsed since the last call
+         */
+        [[nodiscard]] auto state_due(bool const tick) const -> bool {
+            if (!m_publish_policy.enabled()) return tick;
+            motor_telemetry_t const telemetry = m_telemetry.read();
+            return m_publish_policy.should_publish(System::get_ticks(), state_values(telemetry), state_events(telemetry));
         }
 
-        auto drive_output() -> void {
+        // runs from CCM SRAM, along with everything it inlines
+        MROVER_RAMFUNC auto sample_inputs() -> void {
             // update limit switch state
             apply_limit(m_limit_a, m_limit_a_hit, limit_a_forward, limit_a_backward);
             apply_limit(m_limit_b, m_limit_b_hit, limit_b_forward, limit_b_backward);
             m_limit_forward_hit = limit_a_forward || limit_b_forward;
             m_limit_backward_hit = limit_a_backward || limit_b_backward;
             if (m_encoder_mode != encoder_mode_t::NONE) sample_encoder();
+            // the sense offset is only valid with no current flowing, start over if the bridge got driven meanwhile
+            if (!m_current_sensor->calibrated() && !output_idle()) m_current_sensor->calibrate();
+            m_current_sensor->update_triggered();
+        }
+
+        /**
+         * Single loop at the control timer rate, from the main loop.
+         */
+        MROVER_RAMFUNC auto drive_output() -> void {
+            sample_inputs();
             write_output_pwm();
+            publish_telemetry();
+        }
+
+        /**
+         * Whether the loops run from the PWM timer interrupt, see control_hz.
+         */
+        [[nodiscard]] auto control_in_isr() const -> bool {
+            return m_inner_dt > 0.0f;
+        }
+
+        [[nodiscard]] auto inner_loop_period() const -> float {
+            return m_inner_dt;
+        }
+
+        /**
+         * Counts inner loop ticks, true on the ones the outer loop should run on.
+         */
+        auto outer_loop_due() -> bool {
+            if (++m_outer_count < m_outer_div) return false;
+            m_outer_count = 0;
+            return true;
+        }
+
+        /**
+         * Outer position loop, decimated from the inner loop. Call after sample_inputs.
+         * Produces the velocity setpoint the inner loop tracks, with the reference velocity fed forward,
+         * and the acceleration feedforward the inner loop adds to its output.
+         */
+        MROVER_RAMFUNC auto control_outer() -> void {
+            if (!m_enabled) return;
+            auto const dt = m_inner_dt * static_cast<float>(m_outer_div);
+            // the relay commands the inner loop, so the position gains found are velocity per unit of position
+            if (m_mode == mode_t::AUTOTUNE_POSITION) {
+                m_velocity_setpoint = std::clamp(autotune_step(m_position, dt), m_min_velocity, m_max_velocity);
+                m_acceleration_ff = 0.0f;
+                return;
+            }
+            if (m_mode != mode_t::POSITION) return;
+            auto const target_pos = std::clamp(m_target, m_min_position, m_max_position);
+            auto const [ref_pos, ref_vel, ref_acc] = position_reference(target_pos, dt);
+            m_velocity_setpoint = std::clamp(m_pidf->calculate(m_position, ref_pos, dt) + ref_vel, m_min_velocity, m_max_velocity);
+            m_acceleration_ff = m_acceleration_k_f * ref_acc;
+        }
+
+        /**
+         * Inner velocity or current loop on every PWM timer interrupt, with the fixed interrupt period as its time step.
+         * Call after sample_inputs.
+         */
+        MROVER_RAMFUNC auto control_inner() -> void {
+            if (m_enabled) {
+                switch (m_mode) {
+                    case mode_t::STOPPED:
+                    case mode_t::FAULT:
+                        if (m_hbridge->is_on()) m_hbridge->stop();
+                        break;
+                    case mode_t::THROTTLE:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        m_hbridge->write(limit_output(m_target));
+                        break;
+                    case mode_t::VELOCITY:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        {
+                            auto const target_vel = std::clamp(m_target, m_min_velocity, m_max_velocity);
+                            m_hbridge->write(limit_output(m_inner_pidf->calculate(m_velocity, target_vel, m_inner_dt)));
+                        }
+                        break;
+                    case mode_t::POSITION:
+                    case mode_t::AUTOTUNE_POSITION:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        m_hbridge->write(limit_output(std::clamp(m_inner_pidf->calculate(m_velocity, m_velocity_setpoint, m_inner_dt) + m_acceleration_ff, -1.0f, 1.0f)));
+                        break;
+                    case mode_t::AUTOTUNE_VELOCITY:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        m_hbridge->write(limit_output(std::clamp(autotune_step(m_velocity, m_inner_dt), -1.0f, 1.0f)));
+                        break;
+                    case mode_t::CURRENT:
+                        if (!m_hbridge->is_on()) m_hbridge->start();
+                        {
+                            auto const target_cur = std::clamp(m_target, -m_max_current, m_max_current); // amps
+                            auto const input_cur = m_current_sensor->sample_current() * m_current_direction;
+                            m_hbridge->write(limit_output(m_current_pidf->calculate(input_cur, target_cur, m_inner_dt)));
+                        }
+                        break;
+                }
+            }
+            publish_telemetry();
+        }
+
+        // the h-bridge is not being driven, so a flash stall cannot disturb the output
+        [[nodiscard]] auto output_idle() const -> bool {
+            return !m_enabled || m_mode == mode_t::STOPPED || m_mode == mode_t::FAULT;
+        }
+
+        MROVER_RAMFUNC auto capture_encoder_edge() -> void {
+            if (uses_quadrature(m_encoder_mode)) m_quad_encoder->capture_edge();
         }
 
         auto tx_watchdog_lapsed() -> void {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <adc.hpp>
+#include <autotune.hpp>
 #include <hw/ad8418a.hpp>
 #include <hw/flash.hpp>
+#include <limits>
 #include <serial/uart.hpp>
 #include <sys.hpp>
 
@@ -14,11 +16,48 @@ namespace mrover {
         THROTTLE = 5,
         POSITION = 6,
         VELOCITY = 7,
+        CURRENT = 8,
+        AUTOTUNE_POSITION = 9, // relay experiment on the position loop, around the position it started at
+        AUTOTUNE_VELOCITY = 10,
     };
 
     enum struct encoder_mode_t : uint8_t {
         NONE = 0,
         QUAD,
+        ABS,      // ABS board over CAN alone
+        QUAD_ABS, // quadrature calibrated by an ABS board over CAN
+    };
+
+    // modes reading the quadrature encoder, which want its edges captured for the velocity estimate
+    constexpr auto uses_quadrature(encoder_mode_t const mode) -> bool {
+        return mode == encoder_mode_t::QUAD || mode == encoder_mode_t::QUAD_ABS;
+    }
+
+    static_assert(uses_quadrature(encoder_mode_t::QUAD) && uses_quadrature(encoder_mode_t::QUAD_ABS));
+    static_assert(!uses_quadrature(encoder_mode_t::NONE) && !uses_quadrature(encoder_mode_t::ABS));
+
+    // latest control loop sample, handed from the loop to the state publisher
+    struct motor_telemetry_t {
+        float position{std::numeric_limits<float>::quiet_NaN()}; // unit of output
+        float velocity{std::numeric_limits<float>::quiet_NaN()}; // unit of output/second
+        bool limit_a_hit{};
+        bool limit_b_hit{};
+    };
+
+    // latest ABSEncoderState, handed from the CAN interrupt to the loop
+    struct abs_reading_t {
+        float position{};     // unit of output
+        float velocity{};     // unit of output/second
+        uint32_t sample_us{}; // local time the board sampled at
+        uint32_t sequence{};  // zero before the first reading
+    };
+
+    // outcome of a relay experiment, handed from the loop to the main loop to report and apply
+    struct autotune_report_t {
+        mode_t mode{};
+        RelayAutotune::Status status{};
+        RelayAutotune::Result result{};
+        uint32_t sequence{}; // zero before the first experiment ends
     };
 
     /**
@@ -37,13 +76,14 @@ namespace mrover {
     /**
      * Get the BMC ADC settings.
      *
-     * DMA must be enabled to allow non-blocking ADC functionality.
+     * Every TIM1 update triggers a 64x oversampled scan, streamed by circular DMA, so reads never block.
      *
      * @return ADC options for BMC
      */
     inline auto get_adc_options() -> ADCBase::Options {
         ADCBase::Options options;
-        options.use_dma = false; // TODO(eric) use dma for this
+        options.use_dma = true;
+        options.triggered = true;
         return options;
     }
 
@@ -54,6 +94,9 @@ namespace mrover {
         options.vref = 3.3f;
         options.vcm = 1.598f;
         options.adc_resolution = 4095;
+        // middle of each TIM1 pulse, see the sample channel of the h-bridge
+        options.sample_trigger = ADC_EXTERNALTRIGINJEC_T1_CC4;
+        options.sample_channel = ADC_CHANNEL_1;
         return options;
     }
 
@@ -7,6 +7,7 @@
 #include <logger.hpp>
 #include <serial/fdcan.hpp>
 #include <sys.hpp>
+#include <time_sync.hpp>
 #include <timer.hpp>
 
 #include "bmc_config.hpp"
@@ -30,6 +31,7 @@ extern TIM_HandleTypeDef htim17;
 namespace mrover {
 
     static constexpr uint8_t NUM_ADC_CHANNELS = 1;
+    static constexpr size_t ADC_SAMPLES_PER_HALF = 128; // ~208 Hz of averaged readings at the PWM rate
     static constexpr size_t NUM_ELAPSED_TIMER_CHANNELS = 2;
     static constexpr size_t ELAPSED_TIMER_CH_1 = 0;
     static constexpr size_t ELAPSED_TIMER_CH_2 = 1;
@@ -38,21 +40,59 @@ namespace mrover {
     static constexpr ADC_HandleTypeDef* ADC_1 = &hadc1;
     static constexpr FDCAN_HandleTypeDef* FDCAN_1 = &hfdcan1;
 
-    static constexpr TIM_HandleTypeDef* MOTOR_PWM_TIM = &htim1;
+    static constexpr TIM_HandleTypeDef* MOTOR_PWM_TIM = &htim1; // ~26.6 kHz, CH1 drives the bridge, CH4 triggers current sampling, control loops on its update interrupt
     static constexpr TIM_HandleTypeDef* ELAPSED_TIM = &htim2;
     static constexpr TIM_HandleTypeDef* ENCODER_TIM = &htim4;
     static constexpr TIM_HandleTypeDef* TX_TIM = &htim6;        // 10 Hz
     static constexpr TIM_HandleTypeDef* CAN_WWDG_TIM = &htim16; // 10 Hz
     static constexpr TIM_HandleTypeDef* CONTROL_TIM = &htim17;  // 25 Hz
 
+    static constexpr uint32_t HEALTH_PERIOD_MS = 1000;
+
+    // the crash record of the last reset is sent with this many health reports
+    static constexpr uint8_t CRASH_REPORT_COUNT = 5;
+
+    // warn when the stack comes this close to the heap
+    static constexpr uint32_t LOW_MEMORY_BYTES = 512;
+
+    // an ABS timestamp older than this disagrees with our clock rather than being that late
+    static constexpr uint32_t MAX_ABS_AGE_US = 200'000;
+
+    // instrumented tasks, reported in ESWTaskDiagnostics
+    static constexpr uint8_t TASK_LOOP = 0;
+    static constexpr uint8_t TASK_CONTROL = 1;
+    static constexpr uint8_t TASK_TIMER_ISR = 2;
+    static constexpr uint8_t TASK_FDCAN_ISR = 3;
+    static constexpr uint8_t TASK_INNER_LOOP = 4;
+    static constexpr uint8_t TASK_OUTER_LOOP = 5;
+    static constexpr uint8_t TASK_COUNT = 6;
+
     bmc_config_t config;
     bool volatile initialized = false;
     bool volatile tx_pending = false;
     bool volatile control_update = false;
+    uint32_t last_health_tick = 0;
+    uint8_t crash_reports_left = CRASH_REPORT_COUNT;
+    // frames following each health report, one per main loop pass so a burst never outruns the tx fifo
+    uint8_t diagnostics_step = TASK_COUNT + 1;
+
+    // command to actuation latency, measured with the fdcan timestamp counter, worst since the last diagnostics report
+    bool volatile target_pending = false;
+    uint16_t volatile target_rx_timestamp = 0;
+    uint32_t volatile max_target_latency_ns = 0;
+
+    // control loop period jitter and control path cycle count, reported with each config commit
+    uint64_t last_control_us = 0;
+    uint32_t last_control_cycles = 0;
+    uint32_t control_jitter_max_us = 0;
+    uint32_t control_cycles_max = 0;
+
+    // host timebase for state message timestamps
+    TimeSync time_sync;
 
     // Peripherals
     std::optional<UART> lpuart;
-    std::optional<ADC<NUM_ADC_CHANNELS>> adc;
+    std::optional<ADC<NUM_ADC_CHANNELS, ADC_SAMPLES_PER_HALF>> adc;
     std::optional<FDCAN> fdcan;
 
     // Timers
@@ -84,19 +124,170 @@ namespace mrover {
         can_tx->reset();
     }
 
+    /**
+     * Publish the FDCAN error state and statistics.
+     */
+    auto send_health() -> void {
+        send_can_message(fdcan->health().to_message<ESWCANHealth>());
+    }
+
+    /**
+     * Report the fault that caused the last reset, if there was one.
+     */
+    auto send_crash_report() -> void {
+        auto const& crash = System::last_crash();
+        if (!crash) return;
+        send_can_message(ESWCrashReport{
+                static_cast<uint8_t>(crash->reason),
+                crash->pc,
+                crash->lr,
+                crash->psr,
+                crash->cfsr,
+                crash->hfsr,
+                crash->bfar,
+                crash->uptime_ms,
+                crash->can_id(0),
+                crash->can_id(1),
+                crash->can_id(2),
+                crash->can_id(3),
+                crash->can_id(4),
+                crash->can_id(5),
+                crash->can_id(6),
+                crash->can_id(7),
+        });
+    }
+
+    /**
+     * Publish stack and heap high-water marks and CPU load since the last report,
+     * and queue the per task timing and crash report behind them, see send_next_diagnostics.
+     */
+    auto send_diagnostics() -> void {
+        CpuLoad const load = Instrumentation::take_load();
+        System::MemoryUsage const memory = System::memory_usage();
+        uint32_t const latency_us = max_target_latency_ns / 1000;
+        max_target_latency_ns = 0;
+        send_can_message(ESWDiagnostics{
+                load.cpu_load(),
+                static_cast<uint16_t>(load.window_cycles / (SystemCoreClock / 1000U)),
+                load.max_isr_latency_cycles,
+                load.max_isr_cycles,
+                Instrumentation::ENABLED ? TASK_COUNT : uint8_t{0},
+                static_cast<uint16_t>(memory.stack_peak),
+                static_cast<uint16_t>(memory.stack_free),
+                static_cast<uint16_t>(memory.heap_used),
+                static_cast<uint16_t>(memory.heap_failures),
+                static_cast<uint16_t>(std::min<uint32_t>(latency_us, UINT16_MAX)),
+        });
+        if (memory.stack_free < LOW_MEMORY_BYTES || memory.heap_failures != 0) {
+            Logger::instance().warn("low memory: stack peak %lu B, %lu B free, heap %lu B, %lu failed allocations",
+                                    memory.stack_peak, memory.stack_free, memory.heap_used, memory.heap_failures);
+        }
+        // without instrumentation there is no per task timing to follow
+        diagnostics_step = Instrumentation::ENABLED ? 0 : TASK_COUNT;
+    }
+
+    /**
+     * Send the next frame queued behind the last health report, if any.
+     */
+    auto send_next_diagnostics() -> void {
+        if (diagnostics_step < TASK_COUNT) {
+            uint8_t const task = diagnostics_step++;
+            TaskStats const stats = Instrumentation::take_task(task);
+            send_can_message(ESWTaskDiagnostics{
+                    task,
+                    stats.count,
+                    stats.min_cycles,
+                    stats.avg_cycles(),
+                    stats.max_cycles,
+                    stats.max_latency_cycles,
+                    stats.histogram[0],
+                    stats.histogram[1],
+                    stats.histogram[2],
+                    stats.histogram[3],
+                    stats.histogram[4],
+                    stats.histogram[5],
+                    stats.histogram[6],
+                    stats.histogram[7],
+                    stats.histogram[8],
+                    stats.histogram[9],
+                    stats.histogram[10],
+                    stats.histogram[11],
+                    stats.histogram[12],
+                    stats.histogram[13],
+                    stats.histogram[14],
+                    stats.histogram[15],
+            });
+        } else if (diagnostics_step == TASK_COUNT) {
+            ++diagnostics_step;
+            if (crash_reports_left > 0) {
+                send_crash_report();
+                --crash_reports_left;
+            }
+        }
+    }
+
+    /**
+     * Handle the host time sync pair, the sync being back-dated to when it hit the bus.
+     * @return true if the message was a time sync message
+     */
+    auto handle_time_sync(MRoverCANMsg_t const& msg, uint16_t const rx_timestamp) -> bool {
+        if (auto const* sync = std::get_if<ESWTimeSync>(&msg)) {
+            time_sync.on_sync(sync->sequence, System::get_micros64() - fdcan->timestamp_elapsed_ns(rx_timestamp) / 1000);
+            return true;
+        }
+        if (auto const* follow_up = std::get_if<ESWTimeSyncFollowUp>(&msg)) {
+            time_sync.on_follow_up(follow_up->sequence, follow_up->host_time);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Local time an ABS board sampled at, for the fusion to line it up with the quadrature encoder history.
+     * Its timestamp is host time when both boards are synchronized, otherwise the frame reaching the bus has to do.
+     */
+    auto abs_sample_us(ABSEncoderState const& msg, uint16_t const rx_timestamp) -> uint32_t {
+        uint64_t const now_us = System::get_micros64();
+        uint64_t const rx_us = now_us - fdcan->timestamp_elapsed_ns(rx_timestamp) / 1000;
+        if (msg.timestamp != 0 && time_sync.synced(now_us)) {
+            auto const age_us = static_cast<uint32_t>(time_sync.to_host_us(now_us)) - msg.timestamp;
+            // sampled before it went on the bus, the host unwraps the same 32-bit time
+            if (age_us >= now_us - rx_us && age_us < MAX_ABS_AGE_US) return static_cast<uint32_t>(now_us - age_us);
+        }
+        return static_cast<uint32_t>(rx_us);
+    }
+
     /**
      * Receive and parse a CAN message over the bus.
      * Message should be of a type defined in CANBus1.dbc
      */
-    auto receive_can_message() -> void {
+    auto receive_can_message(FDCAN::RxFifo const fifo) -> void {
         if (!initialized) return;
 
-        motor->reset_wwdg();
-
-        while (fdcan->messages_to_process() > 0) {
-            if (auto const recv = can_receiver->receive(); recv) {
+        while (fdcan->messages_to_process(fifo) > 0) {
+            uint16_t rx_timestamp;
+            if (auto const recv = can_receiver->receive(fifo, &rx_timestamp); recv) {
                 can_rx->set();
                 auto const& msg = *recv;
+                if (handle_time_sync(msg, rx_timestamp)) {
+                    can_rx->reset();
+                    continue;
+                }
+                // another board's state, not the host, so it does not feed the watchdog
+                if (auto const* abs = std::get_if<ABSEncoderState>(&msg)) {
+                    motor->receive_absolute(*abs, abs_sample_us(*abs, rx_timestamp));
+                    can_rx->reset();
+                    continue;
+                }
+                motor->reset_wwdg();
+                if (std::holds_alternative<BMCTargetCmd>(msg) || std::holds_alternative<BMCGroupTargetCmd>(msg)) {
+                    target_rx_timestamp = rx_timestamp;
+                    target_pending = true;
+                }
+                // group targets act on the shared frame edge instead of waiting for each joint's control tick
+                if (std::holds_alternative<BMCGroupTargetCmd>(msg)) {
+                    control_update = true;
+                }
                 motor->receive(msg);
                 can_wwdg_tim->reset();
                 can_rx->reset();
@@ -125,6 +316,15 @@ namespace mrover {
         control_tim.emplace(CONTROL_TIM, true);    // control timer (update driven output, on interrupt)
         elapsed_timer.emplace(ELAPSED_TIM, false); // pid compute timer
 
+        // with a publish policy the transmit timer samples state at the capped publish rate
+        if (PublishPolicy<3> const policy{{
+                    .heartbeat_ms = config.get<bmc_config_t::pub_heartbeat_ms>(),
+                    .min_interval_ms = config.get<bmc_config_t::pub_min_interval_ms>(),
+            }};
+            policy.enabled() && policy.options().min_interval_ms != 0) {
+            tx_tim->set_frequency(std::clamp(1000.0f / static_cast<float>(policy.options().min_interval_ms), 10.0f, 100.0f));
+        }
+
         // timer channels
         auto* pid_timer_handle = elapsed_timer->get_handle(ELAPSED_TIMER_CH_1);
         auto* enc_timer_handle = elapsed_timer->get_handle(ELAPSED_TIMER_CH_2);
@@ -138,15 +338,19 @@ namespace mrover {
 
         // setup motor instance
         motor.emplace(
-                HBridge{MOTOR_PWM_TIM, TIM_CHANNEL_1, Pin{MOTOR_DIR_GPIO_Port, MOTOR_DIR_Pin}},
-                AD8418A{&*adc, ADC_CHANNEL_0},
+                HBridge{MOTOR_PWM_TIM, TIM_CHANNEL_1, Pin{MOTOR_DIR_GPIO_Port, MOTOR_DIR_Pin}, TIM_CHANNEL_4},
+                AD8418A{&*adc, 0},
                 LimitSwitch{Pin{LIMIT_A_GPIO_Port, LIMIT_A_Pin}},
                 LimitSwitch{Pin{LIMIT_B_GPIO_Port, LIMIT_B_Pin}},
-                QuadratureEncoder{ENCODER_TIM, enc_timer_handle},
+                QuadratureEncoder{ENCODER_TIM, enc_timer_handle, ELAPSED_TIM},
                 send_can_message,
                 pid_timer_handle,
                 &config);
 
+        if (auto const& crash = System::last_crash()) {
+            Logger::instance().warn("reset after fault %lu at pc 0x%08lx, cfsr 0x%08lx", crash->reason, crash->pc, crash->cfsr);
+        }
+
         // set initialization state and initial error state
         initialized = true;
     }
@@ -154,25 +358,104 @@ namespace mrover {
     [[noreturn]] auto loop() -> void {
         for (;;) {
             // TODO(eric) feels like FreeRTOS would be nice here
+            uint32_t const loop_start = Instrumentation::now();
+            bool tx_tick = false;
             if (tx_pending) {
-                motor->send_state();
+                motor->sample_state();
                 tx_pending = false;
+                tx_tick = true;
+            }
+            // with the loops on the PWM timer interrupt the control timer has nothing left to drive
+            if (control_update && motor->control_in_isr()) {
+                control_update = false;
             }
             if (control_update) {
+                uint64_t const now_us = System::get_micros64();
+                auto const period_us = static_cast<int32_t>(now_us - last_control_us);
+                auto const nominal_us = static_cast<int32_t>(1e6f / control_tim->get_update_frequency());
+                if (last_control_us != 0) {
+                    control_jitter_max_us = std::max(control_jitter_max_us, static_cast<uint32_t>(std::abs(period_us - nominal_us)));
+                }
+                last_control_us = now_us;
+                uint32_t const start_cycles = System::get_cycles();
                 motor->drive_output();
+                uint32_t const control_cycles = System::get_cycles() - start_cycles;
+                control_cycles_max = std::max(control_cycles_max, control_cycles);
+                Instrumentation::record(TASK_CONTROL, control_cycles);
+                if (target_pending) {
+                    if (uint32_t const latency_ns = fdcan->timestamp_elapsed_ns(target_rx_timestamp); latency_ns > max_target_latency_ns) {
+                        max_target_latency_ns = latency_ns;
+                    }
+                    target_pending = false;
+                }
                 control_update = false;
             }
+            if (motor->state_due(tx_tick)) {
+                motor->send_state(time_sync.message_timestamp());
+            }
+            motor->report_autotune();
+            // flash stalls instruction fetch, so config changes are only committed while the motor is not driven
+            if (config.has_uncommitted() && motor->output_idle()) {
+                uint64_t const start_us = System::get_micros64();
+                config.commit();
+                Logger::instance().info("config committed in %lu us, control jitter since last commit %lu us, control path %lu cycles",
+                                        static_cast<uint32_t>(System::get_micros64() - start_us), control_jitter_max_us, control_cycles_max);
+                control_jitter_max_us = 0;
+                control_cycles_max = 0;
+            }
+            fdcan->update_recovery();
+            if (uint32_t const now = System::get_ticks(); now - last_health_tick >= HEALTH_PERIOD_MS) {
+                send_health();
+                send_diagnostics();
+                last_health_tick = now;
+            } else {
+                send_next_diagnostics();
+            }
+            Instrumentation::record(TASK_LOOP, Instrumentation::now() - loop_start);
             System::dsb();
             System::get().wfi();
         }
     }
 
+    /**
+     * Cascaded control loops, on the PWM timer update interrupt when control_hz is set.
+     * The outer loop runs on every outer_loop_div-th tick, ahead of the inner loop it feeds.
+     */
+    MROVER_RAMFUNC auto control_isr_callback() -> void {
+        uint32_t const start_cycles = System::get_cycles();
+        if (last_control_cycles != 0) {
+            auto const period = static_cast<float>(start_cycles - last_control_cycles);
+            float const nominal = motor->inner_loop_period() * static_cast<float>(SystemCoreClock);
+            auto const jitter_us = static_cast<uint32_t>(std::fabs(period - nominal) / static_cast<float>(SystemCoreClock / 1000000U));
+            control_jitter_max_us = std::max(control_jitter_max_us, jitter_us);
+        }
+        last_control_cycles = start_cycles;
+
+        motor->sample_inputs();
+        if (motor->outer_loop_due()) {
+            Instrumentation::Scope const scope{TASK_OUTER_LOOP};
+            motor->control_outer();
+        }
+        {
+            Instrumentation::Scope const scope{TASK_INNER_LOOP};
+            motor->control_inner();
+        }
+        control_cycles_max = std::max(control_cycles_max, System::get_cycles() - start_cycles);
+
+        if (target_pending) {
+            if (uint32_t const latency_ns = fdcan->timestamp_elapsed_ns(target_rx_timestamp); latency_ns > max_target_latency_ns) {
+                max_target_latency_ns = latency_ns;
+            }
+            target_pending = false;
+        }
+    }
+
     /**
      * Callback for timer periods elapsing.
      * Timers have to be started with "HAL_TIM_Base_Start_IT" for this interrupt to work for them.
      * @param htim The timer whose period elapsed
      */
-    auto timer_elapsed_callback(TIM_HandleTypeDef const* htim) -> void {
+    MROVER_RAMFUNC auto timer_elapsed_callback(TIM_HandleTypeDef const* htim) -> void {
         if (!initialized) return;
         if (htim == TX_TIM) {
             tx_pending = true;
@@ -180,6 +463,8 @@ namespace mrover {
             motor->tx_watchdog_lapsed();
         } else if (htim == CONTROL_TIM) {
             control_update = true;
+        } else if (htim == MOTOR_PWM_TIM) {
+            control_isr_callback();
         }
     }
 
@@ -193,6 +478,32 @@ namespace mrover {
         }
     }
 
+    /**
+     * Callback timestamping encoder edges for the edge timing velocity estimator.
+     * @param htim timer handle from callback
+     */
+    MROVER_RAMFUNC auto encoder_capture_callback(TIM_HandleTypeDef const* htim) -> void {
+        if (htim == ENCODER_TIM && motor) {
+            motor->capture_encoder_edge();
+        }
+    }
+
+    /**
+     * Callbacks averaging each half of the circular ADC buffer while the DMA fills the other.
+     * @param hadc ADC handle from callback
+     */
+    auto adc_half_complete_callback(ADC_HandleTypeDef const* hadc) -> void {
+        if (hadc == ADC_1) {
+            adc->handle_half_complete();
+        }
+    }
+
+    auto adc_complete_callback(ADC_HandleTypeDef const* hadc) -> void {
+        if (hadc == ADC_1) {
+            adc->handle_conv_complete();
+        }
+    }
+
 } // namespace mrover
 
 extern "C" {
@@ -205,22 +516,52 @@ void Loop() {
     mrover::loop();
 }
 
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+void HardFault(uint32_t const* frame) {
+    mrover::System::handle_hard_fault(frame);
+}
+
+void Tick() {
+    mrover::System::get_cycles64();
+}
+
+MROVER_RAMFUNC void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_TIMER_ISR, mrover::Instrumentation::timer_latency(htim), true};
     mrover::timer_elapsed_callback(htim);
 }
 
-void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
-    mrover::receive_can_message();
+MROVER_RAMFUNC void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_FDCAN_ISR, 0, true};
+    mrover::fdcan->handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo0, RxFifo0ITs);
+    mrover::receive_can_message(mrover::FDCAN::RxFifo::Fifo0);
+}
+
+// mode and target commands, on the higher priority interrupt line
+MROVER_RAMFUNC void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo1ITs) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_FDCAN_ISR, 0, true};
+    mrover::fdcan->handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo1, RxFifo1ITs);
+    mrover::receive_can_message(mrover::FDCAN::RxFifo::Fifo1);
+}
+
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+    mrover::fdcan->handle_error_status(ErrorStatusITs);
 }
 
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
     mrover::uart_tx_callback(huart);
 }
 
-// TODO(eric) implement
-void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim) {}
-void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef* hfdcan) {}
-void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {}
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+    mrover::adc_half_complete_callback(hadc);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
+    mrover::adc_complete_callback(hadc);
+}
+
+MROVER_RAMFUNC void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim) {
+    mrover::encoder_capture_callback(htim);
+}
+
 // void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {}
 // void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {}
 // void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {}
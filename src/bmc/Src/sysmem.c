@@ -30,6 +30,11 @@
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Number of allocations refused because the heap would have run into the stack
+ */
+static uint32_t __sbrk_failures = 0;
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -69,6 +74,7 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    ++__sbrk_failures;
     errno = ENOMEM;
     return (void *)-1;
   }
@@ -79,6 +85,20 @@ void *_sbrk(ptrdiff_t incr)
   return (void *)prev_heap_end;
 }
 
+/**
+ * @brief Heap statistics for the diagnostics message
+ *
+ * @param heap_end Current end of the heap, '_end' if nothing was allocated yet
+ * @param failures Number of refused allocations since reset
+ */
+void _sbrk_stats(uint8_t **heap_end, uint32_t *failures)
+{
+  extern uint8_t _end; /* Symbol defined in the linker script */
+
+  *heap_end = __sbrk_heap_end != NULL ? __sbrk_heap_end : &_end;
+  *failures = __sbrk_failures;
+}
+
 #if defined(__PICOLIBC__)
   // Picolibc expects syscalls without the leading underscore.
   // This creates a strong alias so that
@@ -44,6 +44,13 @@ defined in linker script */
 .word	_sbss
 /* end address for the .bss section. defined in linker script */
 .word	_ebss
+/* start address for the initialization values of the .ccmram section.
+defined in linker script */
+.word	_siccmram
+/* start address for the .ccmram section. defined in linker script */
+.word	_sccmram
+/* end address for the .ccmram section. defined in linker script */
+.word	_eccmram
 
 .equ  BootRAM,        0xF1E0F85F
 /**
@@ -81,6 +88,23 @@ LoopCopyDataInit:
   adds r4, r0, r3
   cmp r4, r1
   bcc CopyDataInit
+
+/* Copy the code and data placed in CCM SRAM from flash */
+  ldr r0, =_sccmram
+  ldr r1, =_eccmram
+  ldr r2, =_siccmram
+  movs r3, #0
+  b	LoopCopyCcmramInit
+
+CopyCcmramInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyCcmramInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyCcmramInit
   
 /* Zero fill the bss segment. */
   ldr r2, =_sbss
@@ -95,6 +119,20 @@ FillZerobss:
 LoopFillZerobss:
   cmp r2, r4
   bcc FillZerobss
+
+/* Paint the free RAM between the heap start and the stack so the stack high-water mark can be found */
+  ldr r2, =_end
+  mov r4, sp
+  ldr r3, =0xC5C5C5C5
+  b LoopPaintStack
+
+PaintStack:
+  str  r3, [r2]
+  adds r2, r2, #4
+
+LoopPaintStack:
+  cmp r2, r4
+  bcc PaintStack
 /* Call static constructors */
     bl __libc_init_array
 /* Call the application's entry point.*/
@@ -67,6 +67,23 @@ namespace mrover {
             }
         }
 
+        auto handle(ESWConfigBulkData const& msg) -> void {
+            m_message_tx_f(m_config_ptr->handle_bulk(msg));
+        }
+
+        auto handle(ESWConfigBulkCommit const& msg) -> void {
+            ESWConfigBulkAck const ack = m_config_ptr->handle_bulk(msg);
+            m_message_tx_f(ack);
+            if (msg.apply && ack.status == 0) {
+                // re-initialize after configuration is modified
+                init();
+            }
+        }
+
+        auto handle(ESWConfigBulkRead const& msg) const -> void {
+            m_config_ptr->handle_bulk(msg, m_message_tx_f);
+        }
+
         auto handle(LIMResetCmd const& msg) -> void {
             System::reset();
         }
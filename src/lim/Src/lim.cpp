@@ -25,9 +25,27 @@ namespace mrover {
 
     static constexpr TIM_HandleTypeDef* TX_TIM = &htim6; // 10 Hz
 
+    static constexpr uint32_t HEALTH_PERIOD_MS = 1000;
+
+    // the crash record of the last reset is sent with this many health reports
+    static constexpr uint8_t CRASH_REPORT_COUNT = 5;
+
+    // warn when the stack comes this close to the heap
+    static constexpr uint32_t LOW_MEMORY_BYTES = 512;
+
+    // instrumented tasks, reported in ESWTaskDiagnostics
+    static constexpr uint8_t TASK_LOOP = 0;
+    static constexpr uint8_t TASK_TIMER_ISR = 1;
+    static constexpr uint8_t TASK_FDCAN_ISR = 2;
+    static constexpr uint8_t TASK_COUNT = 3;
+
     lim_config_t config;
     bool volatile initialized = false;
     bool volatile tx_pending = false;
+    uint32_t last_health_tick = 0;
+    uint8_t crash_reports_left = CRASH_REPORT_COUNT;
+    // frames following each health report, one per main loop pass so a burst never outruns the tx fifo
+    uint8_t diagnostics_step = TASK_COUNT + 1;
 
     // Peripherals
     std::optional<UART> lpuart;
@@ -60,6 +78,106 @@ namespace mrover {
         can_tx->reset();
     }
 
+    /**
+     * Publish the FDCAN error state and statistics.
+     */
+    auto send_health() -> void {
+        send_can_message(fdcan->health().to_message<ESWCANHealth>());
+    }
+
+    /**
+     * Report the fault that caused the last reset, if there was one.
+     */
+    auto send_crash_report() -> void {
+        auto const& crash = System::last_crash();
+        if (!crash) return;
+        send_can_message(ESWCrashReport{
+                static_cast<uint8_t>(crash->reason),
+                crash->pc,
+                crash->lr,
+                crash->psr,
+                crash->cfsr,
+                crash->hfsr,
+                crash->bfar,
+                crash->uptime_ms,
+                crash->can_id(0),
+                crash->can_id(1),
+                crash->can_id(2),
+                crash->can_id(3),
+                crash->can_id(4),
+                crash->can_id(5),
+                crash->can_id(6),
+                crash->can_id(7),
+        });
+    }
+
+    /**
+     * Publish stack and heap high-water marks and CPU load since the last report,
+     * and queue the per task timing and crash report behind them, see send_next_diagnostics.
+     */
+    auto send_diagnostics() -> void {
+        CpuLoad const load = Instrumentation::take_load();
+        System::MemoryUsage const memory = System::memory_usage();
+        send_can_message(ESWDiagnostics{
+                load.cpu_load(),
+                static_cast<uint16_t>(load.window_cycles / (SystemCoreClock / 1000U)),
+                load.max_isr_latency_cycles,
+                load.max_isr_cycles,
+                Instrumentation::ENABLED ? TASK_COUNT : uint8_t{0},
+                static_cast<uint16_t>(memory.stack_peak),
+                static_cast<uint16_t>(memory.stack_free),
+                static_cast<uint16_t>(memory.heap_used),
+                static_cast<uint16_t>(memory.heap_failures),
+                uint16_t{0}, // takes no commands
+        });
+        if (memory.stack_free < LOW_MEMORY_BYTES || memory.heap_failures != 0) {
+            Logger::instance().warn("low memory: stack peak %lu B, %lu B free, heap %lu B, %lu failed allocations",
+                                    memory.stack_peak, memory.stack_free, memory.heap_used, memory.heap_failures);
+        }
+        // without instrumentation there is no per task timing to follow
+        diagnostics_step = Instrumentation::ENABLED ? 0 : TASK_COUNT;
+    }
+
+    /**
+     * Send the next frame queued behind the last health report, if any.
+     */
+    auto send_next_diagnostics() -> void {
+        if (diagnostics_step < TASK_COUNT) {
+            uint8_t const task = diagnostics_step++;
+            TaskStats const stats = Instrumentation::take_task(task);
+            send_can_message(ESWTaskDiagnostics{
+                    task,
+                    stats.count,
+                    stats.min_cycles,
+                    stats.avg_cycles(),
+                    stats.max_cycles,
+                    stats.max_latency_cycles,
+                    stats.histogram[0],
+                    stats.histogram[1],
+                    stats.histogram[2],
+                    stats.histogram[3],
+                    stats.histogram[4],
+                    stats.histogram[5],
+                    stats.histogram[6],
+                    stats.histogram[7],
+                    stats.histogram[8],
+                    stats.histogram[9],
+                    stats.histogram[10],
+                    stats.histogram[11],
+                    stats.histogram[12],
+                    stats.histogram[13],
+                    stats.histogram[14],
+                    stats.histogram[15],
+            });
+        } else if (diagnostics_step == TASK_COUNT) {
+            ++diagnostics_step;
+            if (crash_reports_left > 0) {
+                send_crash_report();
+                --crash_reports_left;
+            }
+        }
+    }
+
     /**
      * Receive and parse a CAN message over the bus.
      * Message should be of a type defined in MRoverCAN.dbc
@@ -112,6 +230,10 @@ namespace mrover {
                 send_can_message,
                 &config);
 
+        if (auto const& crash = System::last_crash()) {
+            Logger::instance().warn("reset after fault %lu at pc 0x%08lx, cfsr 0x%08lx", crash->reason, crash->pc, crash->cfsr);
+        }
+
         // set initialization state and initial error state
         initialized = true;
     }
@@ -119,10 +241,24 @@ namespace mrover {
     [[noreturn]] auto loop() -> void {
         for (;;) {
             // TODO(eric) feels like FreeRTOS would be nice here
+            uint32_t const loop_start = Instrumentation::now();
             if (tx_pending) {
                 limit_handler->send_state();
                 tx_pending = false;
             }
+            // commit config changes between publishes so the flash stall does not delay one
+            if (config.has_uncommitted() && !tx_pending) {
+                config.commit();
+            }
+            fdcan->update_recovery();
+            if (uint32_t const now = System::get_ticks(); now - last_health_tick >= HEALTH_PERIOD_MS) {
+                send_health();
+                send_diagnostics();
+                last_health_tick = now;
+            } else {
+                send_next_diagnostics();
+            }
+            Instrumentation::record(TASK_LOOP, Instrumentation::now() - loop_start);
             System::dsb();
             System::get().wfi();
         }
@@ -162,22 +298,31 @@ void Loop() {
     mrover::loop();
 }
 
+void HardFault(uint32_t const* frame) {
+    mrover::System::handle_hard_fault(frame);
+}
+
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_TIMER_ISR, mrover::Instrumentation::timer_latency(htim), true};
     mrover::timer_elapsed_callback(htim);
 }
 
 void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs) {
+    mrover::Instrumentation::Scope const scope{mrover::TASK_FDCAN_ISR, 0, true};
+    mrover::fdcan->handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo0, RxFifo0ITs);
     mrover::receive_can_message();
 }
 
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+    mrover::fdcan->handle_error_status(ErrorStatusITs);
+}
+
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
     mrover::uart_tx_callback(huart);
 }
 
 // TODO(eric) implement
 void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef* htim) {}
-void HAL_FDCAN_ErrorCallback(FDCAN_HandleTypeDef* hfdcan) {}
-void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {}
 // void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c) {}
 // void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c) {}
 // void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c) {}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AutonLED.hpp"
+#include "config.hpp"
 #include "stm32g4xx_hal_tim.h"
 #include <MRoverCAN.hpp>
 
@@ -52,6 +53,13 @@ namespace mrover {
             set_led(cmd.red, cmd.green, cmd.blue, cmd.blinking);
         }
 
+        void send_can_health(FDCAN::BusHealth const& health) {
+            m_can_tx.set();
+            const MRoverCANMsg_t msg = health.to_message<ESWCANHealth>();
+            m_can_handler.send(msg, PDLB_CAN_ID, JETSON_CAN_ID);
+            m_can_tx.reset();
+        }
+
         void handle_request() {
             auto const recv = m_can_handler.receive();
             if (recv) {
@@ -14,10 +14,20 @@ namespace mrover {
     PDLB pdlb;
     FDCAN fdcan;
 
+    static constexpr uint32_t HEALTH_PERIOD_MS = 1000;
+
     bool initialized = false;
 
     void event_loop() {
-        while (true) {}
+        uint32_t last_health_tick = 0;
+        while (true) {
+            // recover from bus-off and broadcast CAN health
+            fdcan.update_recovery();
+            if (uint32_t const now = HAL_GetTick(); now - last_health_tick >= HEALTH_PERIOD_MS) {
+                pdlb.send_can_health(fdcan.health());
+                last_health_tick = now;
+            }
+        }
     }
 
     void init() {
@@ -54,8 +64,13 @@ void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs)
     if (!mrover::initialized)
         return;
 
+    mrover::fdcan.handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo0, RxFifo0ITs);
     while (mrover::fdcan.messages_to_process() > 0) {
         mrover::pdlb.handle_request();
     }
 }
+
+void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+    mrover::fdcan.handle_error_status(ErrorStatusITs);
+}
 }
@@ -9,6 +9,8 @@
 #include <hw/pin.hpp>
 #include <config.hpp>
 #include <logger.hpp>
+#include <sys.hpp>
+#include <time_sync.hpp>
 #include <queue>
 #include <string>
 
@@ -36,6 +38,7 @@ namespace mrover {
         Pin m_dbg_led2{};
         Pin m_dbg_led3{};
         MRoverCANHandler m_can_handler{};
+        TimeSync m_time_sync{};
         std::queue<sensor_t>* m_i2c_queue;
         ScienceSensor* m_i2c_sensors[NUM_I2C_SENSORS];
 
@@ -60,6 +63,11 @@ namespace mrover {
         void handle(T const& _) {
         }
 
+        // completes a host time sync started in handle_request
+        void handle(const ESWTimeSyncFollowUp& msg) {
+            m_time_sync.on_follow_up(msg.sequence, msg.host_time);
+        }
+
         // handles a reset command
         void handle(const SCIResetCommand& cmd) {
             if (cmd.clear_faults)
@@ -177,7 +185,8 @@ namespace mrover {
                                                 m_thp_sensor.get_thp().pressure, 
                                                 m_oxygen_sensor.get_oxygen(), 
                                                 m_ozone_sensor.get_ozone(),
-                                                m_co2_sensor.get_co2());
+                                                m_co2_sensor.get_co2(),
+                                                m_time_sync.message_timestamp());
             m_can_handler.send(msg, SB_CAN_ID, JETSON_CAN_ID);
             m_can_tx.reset();
         }
@@ -193,10 +202,21 @@ namespace mrover {
             m_can_tx.reset();
         }
 
-        void handle_request() {
-            auto const recv = m_can_handler.receive();
+        void send_can_health(FDCAN::BusHealth const& health) {
+            m_can_tx.set();
+            const MRoverCANMsg_t msg = health.to_message<ESWCANHealth>();
+            m_can_handler.send(msg, SB_CAN_ID, JETSON_CAN_ID);
+            m_can_tx.reset();
+        }
+
+        void handle_request(FDCAN const& fdcan) {
+            uint16_t rx_timestamp;
+            auto const recv = m_can_handler.receive(FDCAN::RxFifo::Fifo0, &rx_timestamp);
             if (recv) {
                 m_can_rx.set();
+                // back-date the sync to when it hit the bus
+                if (auto const* sync = std::get_if<ESWTimeSync>(&*recv))
+                    m_time_sync.on_sync(sync->sequence, System::get_micros64() - fdcan.timestamp_elapsed_ns(rx_timestamp) / 1000);
                 std::visit([this](auto&& value) { handle(value); }, *recv);
                 m_can_rx.reset();
             }
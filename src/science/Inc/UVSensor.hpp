@@ -14,7 +14,7 @@ namespace mrover {
         // default constructor
         UVSensor() = default;
 
-        // adc_in is a pointer to the desired adc and channel_in is the channel that the UVsensor is on
+        // adc_in is a pointer to the desired adc and channel_in is the position of the UV sensor in its scan sequence, from 0
         UVSensor(ADCBase* adc_in, uint8_t const channel_in)
             : m_adc(adc_in), m_channel(channel_in) {}
 
@@ -28,7 +28,7 @@ namespace mrover {
             m_uv_index = 33.0 * ((float)m_adc->get_channel_value(m_channel) / (float)m_adc_res);
         }
 
-        // polls the sensor for data
+        // polls the sensor for data, a triggered adc keeps converting once started
         void poll() override {
             m_adc->start();
         }
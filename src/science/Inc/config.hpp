@@ -26,13 +26,15 @@ namespace mrover {
         can_opts.delay_compensation = true;
         can_opts.tdc_offset = 13;
         can_opts.tdc_filter = 1;
+        can_opts.timestamp_prescaler = 1;
         return can_opts;
     }
 
-    // retrieves science board adc options
+    // retrieves science board adc options, the sensor state timer triggers 256x oversampled conversions
     inline auto get_adc_options() -> ADCBase::Options {
         ADCBase::Options options;
         options.use_dma = true;
+        options.triggered = true;
         return options;
     }
 
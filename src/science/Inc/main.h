@@ -54,6 +54,7 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
 void PostInit(void);
+void Tick(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
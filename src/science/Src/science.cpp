@@ -5,9 +5,11 @@
 #include "ScienceBoard.hpp"
 #include <MRoverCAN.hpp>
 #include <cstddef>
+#include <optional>
 #include <hw/pin.hpp>
 #include <serial/smbus.hpp>
 #include <logger.hpp>
+#include <sys.hpp>
 #include <config.hpp>
 
 extern TIM_HandleTypeDef htim2;
@@ -33,10 +35,12 @@ namespace mrover {
     static constexpr FDCAN_HandleTypeDef* HFDCAN = &hfdcan1;
     static constexpr ADC_HandleTypeDef* HADC = &hadc1;
     static constexpr size_t NUM_ADC_CHANNELS = 1;
+    static constexpr size_t ADC_SAMPLES_PER_HALF = 1; // a UV reading for every 10 Hz state broadcast
 
     UART lpuart;
     SMBus smbus;
-    ADC<NUM_ADC_CHANNELS> adc;
+    // emplaced in init, an ADC cannot move
+    std::optional<ADC<NUM_ADC_CHANNELS, ADC_SAMPLES_PER_HALF>> adc;
     FDCAN fdcan;
     ScienceBoard science_board;
 
@@ -47,6 +51,9 @@ namespace mrover {
 
     void event_loop() {
         while (true) {
+            // recover from bus-off here, the reset reinitializes the peripheral under the interrupts using it
+            fdcan.update_recovery();
+
             // check if reinit sensors timer has expired
             if (HAL_I2C_GetState(HI2C) == HAL_I2C_STATE_READY && restart_sensors) {
                 mrover::science_board.restart_sensors();
@@ -66,10 +73,13 @@ namespace mrover {
     }
 
     void init() {
+        // enables the cycle counter used for the time sync timebase
+        System::get().init();
+
         // initialize interfaces
         lpuart = UART{HLPUART, get_uart_options()};
         smbus = SMBus{HI2C, I2C_WD_TIM, get_smbus_options()};
-        adc = ADC<NUM_ADC_CHANNELS>{HADC, get_adc_options()};
+        adc.emplace(HADC, get_adc_options());
         fdcan = FDCAN{HFDCAN, get_can_options()};
 
         // initialize logger
@@ -81,7 +91,7 @@ namespace mrover {
         auto co2_sensor = CO2Sensor{&smbus};
         auto ozone_sensor = OzoneSensor{&smbus};
         auto oxygen_sensor = OxygenSensor{&smbus};
-        auto uv_sensor = UVSensor{&adc, ADC_CHANNEL_0};
+        auto uv_sensor = UVSensor{&*adc, 0};
 
         // initialize CAN handler and LEDs
         auto can_handler = MRoverCANHandler{&fdcan};
@@ -149,6 +159,10 @@ extern "C" {
         mrover::init();
     }
 
+    void Tick() {
+        mrover::System::get_cycles64();
+    }
+
     void HAL_TIM_PeriodElapsedCallback (TIM_HandleTypeDef *htim) {
         if (htim == mrover::CO2_TX_TIM) {
             // stop tx timer and request co2 data
@@ -179,6 +193,9 @@ extern "C" {
             // attempt to reinitialize any faulty sensors
             if (mrover::initialized)
                 mrover::restart_sensors = true;
+            // broadcast CAN health, recovery runs in the event loop
+            if (mrover::initialized)
+                mrover::science_board.send_can_health(mrover::fdcan.health());
         } else if (htim == mrover::SENSOR_STATE_TIM) {
             // broadcast sensor state over CAN
             if (mrover::initialized)
@@ -209,16 +226,27 @@ extern "C" {
         if (!mrover::initialized)
             return;
 
+        mrover::fdcan.handle_rx_fifo_status(mrover::FDCAN::RxFifo::Fifo0, RxFifo0ITs);
         while (mrover::fdcan.messages_to_process() > 0) {
-            mrover::science_board.handle_request();
+            mrover::science_board.handle_request(mrover::fdcan);
         }
     }
 
+    void HAL_FDCAN_ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t ErrorStatusITs) {
+        mrover::fdcan.handle_error_status(ErrorStatusITs);
+    }
+
     void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
         mrover::handle_i2c_error(); 
     }
 
+    void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+        mrover::adc->handle_half_complete();
+    }
+
     void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
+        mrover::adc->handle_conv_complete();
+
         // update uv_index if the UVSensor has been initialized
         if (mrover::initialized)
             mrover::science_board.update_sensor(mrover::sensor_t::sensor_uv);
@@ -199,7 +199,7 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+  Tick();
   /* USER CODE END SysTick_IRQn 1 */
 }
 
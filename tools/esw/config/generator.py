@@ -3,7 +3,7 @@ import yaml
 from datetime import datetime
 from jinja2 import Environment, FileSystemLoader, StrictUndefined
 
-from esw.config.types import ChipInfo, TypeInfo, chips, types, can_id_types
+from esw.config.types import ChipInfo, TypeInfo, chips, types, can_id_types, can_bit_timings
 
 
 class ConfigGen:
@@ -106,11 +106,44 @@ class ConfigGen:
 
         if can_filtering.get("delay_compensation") is None:
             raise ValueError("Missing required field 'delay_compensation' in can")
-        if can_filtering.get("tdc_offset") is None:
-            raise ValueError("Missing required field 'tdc_offset' in can")
+        if can_filtering.get("bit_timing") is not None:
+            can_filtering["bit_timing"] = self.validate_bit_timing(can_filtering["bit_timing"])
+        if can_filtering.get("tdc_offset") is None and can_filtering.get("bit_timing") is None:
+            raise ValueError("Missing required field 'tdc_offset' in can, required unless a bit_timing profile computes it")
         if can_filtering.get("tdc_filter") is None:
             raise ValueError("Missing required field 'tdc_filter' in can")
 
+        for key in ("fifo0_irq_priority", "fifo1_irq_priority"):
+            priority: int | None = can_filtering.get(key)
+            if priority is not None and not 0 <= priority <= 15:
+                raise ValueError(f"{key} must be an NVIC priority in [0, 15], value: {priority}")
+
+        timestamp_prescaler: int | None = can_filtering.get("timestamp_prescaler")
+        if timestamp_prescaler is not None and not 1 <= timestamp_prescaler <= 16:
+            raise ValueError(f"timestamp_prescaler must be in [1, 16], value: {timestamp_prescaler}")
+
+        if can_filtering.get("priority_msgs") is not None:
+            for msg in can_filtering["priority_msgs"]:
+                if msg.get("name") is None:
+                    raise ValueError(
+                        "Missing required field 'name' in a priority msg, should specify the DBC message to prioritize"
+                    )
+                msg["fifo"] = self.validate_fifo(msg.get("fifo", 1))
+                # a source register subscribes to another node's messages whoever they are addressed to
+                src_reg: str | None = msg.get("src_reg")
+                if src_reg is not None:
+                    if msg.get("dest_reg") is not None:
+                        raise ValueError(f"priority msg {msg['name']} can match on src_reg or dest_reg, not both")
+                    if src_reg.upper() not in reg_names:
+                        raise ValueError(f"src_reg is not a defined register, value: {src_reg}")
+                    continue
+                # the destination byte defaults to this node's id, a group register lets several nodes share a frame
+                dest_reg: str = msg.setdefault("dest_reg", can_reg)
+                if dest_reg.upper() not in reg_names:
+                    raise ValueError(f"dest_reg is not a defined register, value: {dest_reg}")
+
+        can_filtering["fifo"] = self.validate_fifo(can_filtering.get("fifo", 0))
+
         if can_filtering.get("can_subs") is not None:
             for sub in can_filtering["can_subs"]:
                 src_id: int | None = sub.get("can_id")
@@ -127,4 +160,29 @@ class ConfigGen:
 
                 resolved_src_id_type = can_id_types.get(src_id_type)
                 if resolved_src_id_type is None:
-                    raise ValueError(f"Unsuported CAN id type: {sub['type']}")
+                    raise ValueError(f"Unsuported CAN id type: {sub['id_type']}")
+                sub["id_type"] = resolved_src_id_type
+                sub["fifo"] = self.validate_fifo(sub.get("fifo", 0))
+
+    @staticmethod
+    def validate_bit_timing(bit_timing: str | dict) -> dict:
+        if isinstance(bit_timing, str):
+            if bit_timing not in can_bit_timings:
+                raise ValueError(f"Unknown bit_timing profile: {bit_timing}, expected one of {list(can_bit_timings)}")
+            return can_bit_timings[bit_timing]
+
+        for key in ("kernel_clock", "clock_divider", "nominal_bitrate", "data_bitrate"):
+            if bit_timing.get(key) is None:
+                raise ValueError(f"Missing required field '{key}' in bit_timing")
+        # the firmware computes the segments at compile time, catch the obvious mistakes here with a readable error
+        clock = bit_timing["kernel_clock"] // bit_timing["clock_divider"]
+        for key in ("nominal_bitrate", "data_bitrate"):
+            if clock % bit_timing[key] != 0:
+                raise ValueError(f"{key} {bit_timing[key]} does not divide the {clock} Hz FDCAN clock")
+        return bit_timing
+
+    @staticmethod
+    def validate_fifo(fifo: int) -> str:
+        if fifo not in (0, 1):
+            raise ValueError(f"Unsupported CAN rx fifo: {fifo}, must be 0 or 1")
+        return f"Fifo{fifo}"
@@ -1,3 +1,4 @@
+import struct
 from pathlib import Path
 from typing import Any
 
@@ -84,6 +85,24 @@ def parse_config(definition_yaml: Path, config_yaml: Path) -> dict[str, dict[str
     return registers
 
 
+def decode_config(definition_yaml: Path, raw_registers: dict[int, int]) -> dict[str, Any]:
+    """Turn raw register values read from a board back into configuration file fields."""
+    config_map = load_definition(definition_yaml)
+    fields: dict[str, Any] = {}
+    for field, info in config_map.items():
+        raw = raw_registers.get(info["addr"])
+        if raw is None:
+            continue
+        dtype = info["dtype"]
+        if dtype is float:
+            fields[field] = struct.unpack("<f", struct.pack("<I", raw & 0xFFFFFFFF))[0]
+        elif dtype is bool:
+            fields[field] = bool((raw >> info["offset"]) & 1)
+        else:
+            fields[field] = (raw >> info["offset"]) & ((1 << info["width"]) - 1)
+    return fields
+
+
 def display_config(registers: dict[str, dict[str, int]]) -> None:
     print(f"{'Register':<24} {'Addr':<8} {'Value':<16}")
     print("-" * 52)
@@ -53,6 +53,13 @@ chips: dict[str, ChipInfo] = {"STM32G431CBTx": ChipInfo(0x08000000, 0x0801FFFF,
 # shorthand for can id types
 can_id_types: dict[str, str] = {"ext": "Extended"}
 
+# named nominal/data bitrate profiles, kernel_clock is the FDCAN kernel clock before the FDCAN clock divider
+# 8 Mbps does not divide 170 MHz, so 1m8m needs the FDCAN kernel clock moved to a 160 MHz PLLQ in CubeMX
+can_bit_timings: dict[str, dict[str, int]] = {
+    "1m5m": {"kernel_clock": 170_000_000, "clock_divider": 2, "nominal_bitrate": 1_000_000, "data_bitrate": 5_000_000},
+    "1m8m": {"kernel_clock": 160_000_000, "clock_divider": 2, "nominal_bitrate": 1_000_000, "data_bitrate": 8_000_000},
+}
+
 
 @dataclass
 class RegGenResult:
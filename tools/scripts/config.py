@@ -1,11 +1,75 @@
 import argparse
+import zlib
 from pathlib import Path
-from time import sleep
+from time import monotonic, sleep
+
+import yaml
 
 from esw import esw_logger
 from esw.can.dbc import get_dbc
 from esw.can.canbus import CANBus, float2bits
-from esw.config.parser import parse_config, display_config
+from esw.config.parser import parse_config, display_config, decode_config
+
+# pairs carried by one ESWConfigBulkData frame
+BULK_PAIRS_PER_FRAME = 12
+ACK_TIMEOUT = 0.5
+STATUS_OK = 0
+
+
+def to_bits(val: int | float) -> int:
+    if isinstance(val, float):
+        return float2bits(val)
+    return val
+
+
+def wait_for(bus: CANBus, msg_name: str, node_id: int, timeout: float = ACK_TIMEOUT) -> dict | None:
+    deadline = monotonic() + timeout
+    while (remaining := deadline - monotonic()) > 0:
+        recv = bus.recv(timeout=remaining)
+        if recv is None:
+            break
+        name, signals, src_id, _ = recv
+        if name == msg_name and int(src_id) == node_id:
+            return signals
+    return None
+
+
+def bulk_write(bus: CANBus, node_id: int, pairs: list[tuple[int, int]]) -> bool:
+    """Stage every register in numbered frames, then commit them with a CRC in one flash program."""
+    crc = 0
+    frames = [pairs[i : i + BULK_PAIRS_PER_FRAME] for i in range(0, len(pairs), BULK_PAIRS_PER_FRAME)]
+    for sequence, frame in enumerate(frames):
+        signals = {"sequence": sequence, "count": len(frame)}
+        for k in range(BULK_PAIRS_PER_FRAME):
+            addr, val = frame[k] if k < len(frame) else (0, 0)
+            signals[f"address_{k}"] = addr
+            signals[f"value_{k}"] = val
+        for addr, val in frame:
+            crc = zlib.crc32(bytes([addr]) + val.to_bytes(4, "little"), crc)
+        bus.send("ESWConfigBulkData", signals, dest_id=node_id)
+
+        ack = wait_for(bus, "ESWConfigBulkAck", node_id)
+        if ack is None or int(ack["status"]) != STATUS_OK:
+            esw_logger.error(f"Frame {sequence} rejected: {ack}")
+            bus.send("ESWConfigBulkCommit", {"frames": 0, "crc": 0, "apply": 0}, dest_id=node_id)
+            return False
+
+    bus.send("ESWConfigBulkCommit", {"frames": len(frames), "crc": crc, "apply": 1}, dest_id=node_id)
+    ack = wait_for(bus, "ESWConfigBulkAck", node_id)
+    if ack is None or int(ack["status"]) != STATUS_OK:
+        esw_logger.error(f"Commit rejected: {ack}")
+        return False
+    esw_logger.info(f"Committed {int(ack['count'])} registers in {len(frames)} frames")
+    return True
+
+
+def bulk_read(bus: CANBus, node_id: int) -> dict[int, int]:
+    bus.send("ESWConfigBulkRead", {"start_address": 0, "length": 0xFF}, dest_id=node_id)
+    registers: dict[int, int] = {}
+    while (data := wait_for(bus, "ESWConfigBulkData", node_id)) is not None:
+        for k in range(int(data["count"])):
+            registers[int(data[f"address_{k}"])] = int(data[f"value_{k}"])
+    return registers
 
 
 if __name__ == "__main__":
@@ -44,31 +108,41 @@ if __name__ == "__main__":
         action="store_true",
         help="Read configuration from device and save to file",
     )
+    parser.add_argument(
+        "--legacy",
+        action="store_true",
+        help="Write one register per ESWConfigCmd, for firmware without bulk configuration",
+    )
     args = parser.parse_args()
 
-    # read config file
-    cfg = parse_config(args.definition, args.file)
-    display_config(cfg)
     node_id = args.id
 
     # open bus
     with CANBus(get_dbc(dbc_name="MRoverCAN"), args.can) as bus:
         if args.read:
-            # TODO read all configs
-            pass
+            registers = bulk_read(bus, node_id)
+            if not registers:
+                esw_logger.error("No configuration received")
+            else:
+                fields = decode_config(args.definition, registers)
+                with open(args.file, "w") as f:
+                    yaml.safe_dump(fields, f, sort_keys=False)
+                esw_logger.info(f"Read {len(registers)} registers into {args.file}")
         else:
-            # send all configs
-            for reg, info in cfg.items():
-                addr = info["addr"]
-                val = info["value"]
-                esw_logger.info(f"Configured {reg} - ADDR 0x{addr:x} @ {val}")
-                val_bits: int
-                if isinstance(val, float):
-                    val_bits = float2bits(val)
-                else:
-                    val_bits = val
-                bus.send("ESWConfigCmd", {"address": addr, "value": val_bits, "apply": 0x1}, dest_id=node_id)
-                sleep(0.1)
+            # read config file
+            cfg = parse_config(args.definition, args.file)
+            display_config(cfg)
+
+            if args.legacy:
+                # send all configs
+                for reg, info in cfg.items():
+                    addr = info["addr"]
+                    val = info["value"]
+                    esw_logger.info(f"Configured {reg} - ADDR 0x{addr:x} @ {val}")
+                    bus.send("ESWConfigCmd", {"address": addr, "value": to_bits(val), "apply": 0x1}, dest_id=node_id)
+                    sleep(0.1)
+            elif not bulk_write(bus, node_id, [(info["addr"], to_bits(info["value"])) for info in cfg.values()]):
+                raise SystemExit(1)
 
         sleep(1)
         esw_logger.info("Configuration Complete!")
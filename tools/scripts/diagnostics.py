@@ -0,0 +1,45 @@
+from time import sleep
+
+from esw import esw_logger
+from esw.can.canbus import CANBus
+from esw.can.dbc import get_dbc
+
+if __name__ == "__main__":
+    CPU_FREQUENCY_MHZ = 170
+    HISTOGRAM_FIRST_BIT = 7
+
+    def cycles_to_us(cycles):
+        return int(cycles) / CPU_FREQUENCY_MHZ
+
+    def on_msg_recv(msg):
+        msg_name, signals, src_id, dest_id = msg
+        if msg_name == "ESWDiagnostics":
+            esw_logger.info(
+                f"[0x{int(src_id):02x}] cpu load {int(signals['cpu_load']) / 100:.2f} % over {int(signals['window_ms'])} ms, "
+                f"isr latency max {cycles_to_us(signals['max_isr_latency']):.2f} us, "
+                f"isr duration max {cycles_to_us(signals['max_isr_duration']):.2f} us, "
+                f"stack peak {int(signals['stack_peak'])} B ({int(signals['stack_free'])} B free), "
+                f"heap {int(signals['heap_used'])} B ({int(signals['heap_failures'])} failed allocations), "
+                f"command latency max {int(signals['max_command_latency'])} us"
+            )
+        elif msg_name == "ESWCrashReport":
+            can_ids = " ".join(f"0x{int(signals[f'can_id_{k}']):08x}" for k in range(8))
+            esw_logger.warning(
+                f"[0x{int(src_id):02x}] reset after {signals['reason']} at {int(signals['uptime'])} ms: "
+                f"pc 0x{int(signals['pc']):08x} lr 0x{int(signals['lr']):08x} psr 0x{int(signals['psr']):08x} "
+                f"cfsr 0x{int(signals['cfsr']):08x} hfsr 0x{int(signals['hfsr']):08x} bfar 0x{int(signals['bfar']):08x}, "
+                f"last CAN ids {can_ids}"
+            )
+        elif msg_name == "ESWTaskDiagnostics":
+            # histogram bin k counts durations below 2^(k + HISTOGRAM_FIRST_BIT) cycles, the last bin is open ended
+            histogram = " ".join(str(int(signals[f"histogram_{k}"])) for k in range(16))
+            esw_logger.info(
+                f"[0x{int(src_id):02x}] task {int(signals['task'])}: {int(signals['count'])} runs, "
+                f"min/avg/max {cycles_to_us(signals['min_cycles']):.2f}/{cycles_to_us(signals['avg_cycles']):.2f}/"
+                f"{cycles_to_us(signals['max_cycles']):.2f} us, "
+                f"latency max {cycles_to_us(signals['max_latency_cycles']):.2f} us, histogram [{histogram}]"
+            )
+
+    with CANBus(get_dbc(dbc_name="MRoverCAN"), "can1", on_recv=on_msg_recv) as bus:
+        while True:
+            sleep(1)
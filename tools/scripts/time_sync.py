@@ -0,0 +1,91 @@
+import argparse
+from pathlib import Path
+from time import sleep, time_ns
+
+import yaml
+
+from esw import esw_logger
+from esw.can.canbus import CANBus
+from esw.can.dbc import get_dbc
+
+# nodes accept the sync pair whatever its destination, one broadcast frame reaches them all at the same instant
+BROADCAST_ID = 0xFF
+
+
+def node_ids(files: list[Path], ids: list[int]) -> set[int]:
+    """CAN IDs from rover configuration files and the command line."""
+    nodes = set(ids)
+    for file in files:
+        with open(file) as f:
+            nodes.add(int(yaml.safe_load(f)["can_id"]))
+    return nodes
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Synchronize Board Clocks to the Host via CAN")
+    parser.add_argument(
+        "--can",
+        "-c",
+        type=str,
+        default="can1",
+        help="CAN Network of Devices",
+    )
+    parser.add_argument(
+        "--file",
+        "-f",
+        type=Path,
+        nargs="*",
+        default=[],
+        help="Board Configuration Files of the Devices to Report on",
+    )
+    parser.add_argument(
+        "--id",
+        "-i",
+        type=lambda s: int(s, 0),
+        nargs="*",
+        default=[],
+        help="CAN IDs of Devices to Report on",
+    )
+    parser.add_argument(
+        "--period",
+        "-p",
+        type=float,
+        default=1.0,
+        help="Seconds Between Sync Rounds",
+    )
+    args = parser.parse_args()
+
+    SRC_ID = 0x10
+    nodes = node_ids(args.file, args.id)
+    if not nodes:
+        esw_logger.warning("No devices given, reporting on every device heard")
+    heard: set[int] = set()
+
+    def on_msg_recv(msg):
+        msg_name, signals, src_id, dest_id = msg
+        src_id = int(src_id)
+        if nodes and src_id not in nodes:
+            return
+        # state messages carry the low 32 bits of host time in microseconds, 0 until the node is synchronized
+        if "timestamp" in signals:
+            heard.add(src_id)
+            timestamp = int(signals["timestamp"])
+            host_us = time_ns() // 1000
+            if timestamp == 0:
+                esw_logger.info(f"[0x{src_id:02x}] {msg_name}: not synchronized")
+            else:
+                age_us = (host_us - timestamp) & 0xFFFFFFFF
+                esw_logger.info(f"[0x{src_id:02x}] {msg_name}: sample age {age_us} us")
+
+    with CANBus(get_dbc(dbc_name="MRoverCAN"), args.can, on_recv=on_msg_recv) as bus:
+        sequence = 0
+        while True:
+            # the follow-up carries the time the sync left the host, each node timestamps its arrival
+            bus.send("ESWTimeSync", {"sequence": sequence}, src_id=SRC_ID, dest_id=BROADCAST_ID)
+            host_us = time_ns() // 1000
+            bus.send("ESWTimeSyncFollowUp", {"sequence": sequence, "host_time": host_us}, src_id=SRC_ID, dest_id=BROADCAST_ID)
+            sequence = (sequence + 1) & 0xFF
+            sleep(args.period)
+            if silent := sorted(nodes - heard):
+                esw_logger.warning(f"No timestamped state from {', '.join(f'0x{n:02x}' for n in silent)}")
+            heard.clear()